@@ -7,6 +7,7 @@
 #include <Visitor.hpp>
 #include <NonConstVisitor.hpp>
 #include <Token.hpp>
+#include <Symbol.hpp>
 
 namespace Pascal
 {
@@ -65,8 +66,9 @@ namespace Pascal
 		
 		struct VarDeclNode : public DeclarationNode
 		{
-			VarDeclNode(Token name, std::unique_ptr<TypeNode> type, bool isConst)
-				: name(name), type(std::move(type)), isConst(isConst)
+			VarDeclNode(Token name, std::unique_ptr<TypeNode> type, bool isConst,
+						std::unique_ptr<ExpressionNode> value = nullptr)
+				: name(name), type(std::move(type)), isConst(isConst), value(std::move(value))
 			{ }
 			
 			void accept(Visitor* visitor) const
@@ -78,6 +80,12 @@ namespace Pascal
 			Token name;
 			std::unique_ptr<TypeNode> type;
 			bool isConst;
+
+			// Value of a constant, nullptr for variables
+			std::unique_ptr<ExpressionNode> value;
+
+			// Filled by name resolution (UndeclRedefinitionVisitor)
+			mutable SymbolRef symbol;
 		};
 		
 		struct TypeNode : public Node
@@ -112,6 +120,13 @@ namespace Pascal
 			std::vector<std::unique_ptr<VarDeclNode>> params;
 			std::vector<std::unique_ptr<VarDeclNode>> decls;
 			std::unique_ptr<CompoundNode> compound;
+
+			// Set when analysis results were taken from AnalysisCache,
+			// checking passes don't need to look into the body then
+			bool isCached = false;
+
+			// Filled by name resolution (UndeclRedefinitionVisitor)
+			mutable SymbolRef symbol;
 		};
 		
 		struct AssignmentNode : public StmtNode
@@ -143,6 +158,9 @@ namespace Pascal
 			{ visitor->visitVarNode(*this); }
 
 			Token token;
+
+			// Filled by name resolution (UndeclRedefinitionVisitor)
+			mutable SymbolRef symbol;
 		};
 		
 		struct IntLiteralNode : public ExpressionNode
@@ -206,6 +224,9 @@ namespace Pascal
 
 			std::vector<std::unique_ptr<ExpressionNode>> args;
 			Token name;
+
+			// Filled by name resolution (UndeclRedefinitionVisitor)
+			mutable SymbolRef symbol;
 		};
 
 		struct FunctionDeclNode : public DeclarationNode
@@ -229,6 +250,9 @@ namespace Pascal
 			std::vector<std::unique_ptr<VarDeclNode>> params;
 			std::vector<std::unique_ptr<VarDeclNode>> decls;
 			std::unique_ptr<CompoundNode> compound;
+
+			// Filled by name resolution (UndeclRedefinitionVisitor)
+			mutable SymbolRef symbol;
 		};
 
 		struct FunctionCallNode : ExpressionNode
@@ -249,6 +273,9 @@ namespace Pascal
 
 			Token name;
 			std::vector<std::unique_ptr<VarDeclNode>> args;
+
+			// Filled by name resolution (UndeclRedefinitionVisitor)
+			mutable SymbolRef symbol;
 		};
 
 		struct IfNode : StmtNode
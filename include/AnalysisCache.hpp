@@ -0,0 +1,93 @@
+#ifndef PASCAL_ANALYSIS_CACHE_HPP
+#define PASCAL_ANALYSIS_CACHE_HPP
+
+#include <ASTForwards.hpp>
+#include <ReportsManager.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Pascal
+{
+	// On-disk cache of per-procedure analysis results.
+	//
+	// Key of a procedure is a hash of its tokens with their offsets from
+	// its name (cached reports are replayed at those offsets), signatures
+	// of the global names it refers to (as they are seen at the point of
+	// declaration) and the compiler flags. Every entry is a separate file named by the key,
+	// so changing anything a procedure depends on just makes a new key.
+	// Entries that can't be read or don't match the format version are
+	// treated as misses.
+	class AnalysisCache : public ReportListener
+	{
+	public:
+		AnalysisCache(std::string const& directory, std::vector<std::string> const& args);
+
+		// Computes keys of all procedures, loads their entries and sets
+		// `isCached` on hits. Cached diagnostics are reported again.
+		void prepare(AST::ProgramNode& tree);
+
+		// Stores entries of procedures that were analyzed in this run.
+		void commit();
+
+		void onReport(size_t where, ReportType type, std::string const& msg);
+
+		// Globals a procedure reads and assigns. Passes that skip the body of
+		// a cached procedure use it to keep track of the global state.
+		struct Summary
+		{
+			std::vector<std::string> used;
+			std::vector<std::string> initialized;
+		};
+
+		Summary const& getSummary(const AST::ProcDeclNode& node) const;
+
+		void printStats(std::ostream& out) const;
+
+		static const char* const FormatVersion;
+
+	private:
+		struct CachedReport
+		{
+			ReportType type;
+			int64_t offset;
+			std::string msg;
+		};
+
+		struct Entry
+		{
+			uint64_t key;
+			size_t start, end;
+			bool hit;
+			std::vector<CachedReport> reports;
+			Summary summary;
+		};
+
+		std::string directory;
+		uint64_t flagsHash;
+
+		std::unordered_map<const AST::ProcDeclNode*, Entry> entries;
+		std::vector<const AST::ProcDeclNode*> order;
+
+		struct Report
+		{
+			size_t where;
+			ReportType type;
+			std::string msg;
+		};
+
+		std::vector<Report> recorded;
+
+		unsigned hits, misses, stores, invalid;
+
+		std::string entryPath(uint64_t key) const;
+
+		bool load(Entry& entry);
+		bool store(Entry const& entry);
+	};
+} // namespace Pascal
+
+#endif // PASCAL_ANALYSIS_CACHE_HPP
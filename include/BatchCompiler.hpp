@@ -0,0 +1,48 @@
+#ifndef PASCAL_BATCH_COMPILER_HPP
+#define PASCAL_BATCH_COMPILER_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace Pascal
+{
+	// Compiles many programs in one process on a pool of worker threads
+	// (`-j N`). Every file gets its own Driver, and the output file is named
+	// after the input one. Diagnostics are printed in the order of the files
+	// on the command line.
+	class BatchCompiler
+	{
+	public:
+		BatchCompiler(std::vector<std::string> const& args);
+
+		// Returns the combined exit status: the worst one of all files
+		int run();
+
+		// `-j N` or `-jN`. Zero or no option at all means the number of
+		// hardware threads.
+		static unsigned GetThreadsCount(std::vector<std::string> const& args);
+
+		static bool IsRequested(std::vector<std::string> const& args);
+
+	private:
+		struct Job
+		{
+			std::string inFileName;
+			std::string outFileName;
+			std::string diagnostics;
+			int status;
+		};
+
+		std::vector<std::string> args;
+		std::vector<Job> jobs;
+		unsigned threadsCount;
+
+		std::atomic<size_t> nextJob;
+
+		void worker();
+		void compile(Job& job);
+	};
+} // namespace Pascal
+
+#endif // PASCAL_BATCH_COMPILER_HPP
@@ -0,0 +1,41 @@
+#ifndef PASCAL_CALL_GRAPH_HPP
+#define PASCAL_CALL_GRAPH_HPP
+
+#include <IR.hpp>
+
+#include <vector>
+
+namespace Pascal
+{
+	// Calls between the functions of a module, by function index. Built
+	// once, the module must not change while it is used.
+	class CallGraph
+	{
+	public:
+		explicit CallGraph(IR::Module const& module);
+
+		size_t size() const { return m_Callees.size(); }
+
+		// Functions called directly, each one once
+		std::vector<unsigned> const& callees(unsigned function) const { return m_Callees[function]; }
+
+		// Through one call or more
+		bool reaches(unsigned from, unsigned to) const { return m_Reaches[from][to]; }
+
+		// May be active more than once at a time
+		bool isRecursive(unsigned function) const { return reaches(function, function); }
+
+		// Has a path to its return calling only functions that may return.
+		// A recursive function that has none never stops calling itself.
+		bool mayReturn(unsigned function) const { return m_Returns[function]; }
+
+	private:
+		std::vector<std::vector<unsigned>> m_Callees;
+		std::vector<std::vector<bool>> m_Reaches;
+		std::vector<bool> m_Returns;
+
+		bool findsReturn(IR::Function const& function) const;
+	};
+} // namespace Pascal
+
+#endif // PASCAL_CALL_GRAPH_HPP
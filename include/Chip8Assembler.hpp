@@ -0,0 +1,48 @@
+#ifndef PASCAL_CHIP8_ASSEMBLER_HPP
+#define PASCAL_CHIP8_ASSEMBLER_HPP
+
+#include <Chip8Code.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Pascal
+{
+	// Encodes the instruction records of the code generator into a CHIP-8
+	// ROM. The first pass places labels, the second one writes every
+	// instruction as a big-endian word into a single buffer, loaded at
+	// 0x200.
+	class Chip8Assembler
+	{
+	public:
+		static const unsigned LoadAddress = 0x200;
+		static const unsigned MemorySize = 0x1000;
+
+		// Returns false on an undefined label or a program that doesn't fit
+		// into the memory along with the bytes it reserves past its end.
+		// The size is known even then.
+		bool assemble(Chip8::Code const& code);
+
+		std::string const& getRom() const { return rom; }
+		unsigned getSize() const { return size; }
+
+		// First error found, empty if there is none
+		std::string const& getError() const { return error; }
+
+	private:
+		// Address of every label of the code, -1 until placed
+		std::vector<unsigned> labels;
+
+		std::string rom;
+		unsigned size = 0;
+		std::string error;
+
+		bool encode(Chip8::Code const& code, Chip8::Instr const& instr, uint16_t& word);
+
+		bool address(Chip8::Code const& code, Chip8::Instr const& instr, uint16_t& value);
+		bool fail(std::string const& msg);
+	}; // class Chip8Assembler
+} // namespace Pascal
+
+#endif // PASCAL_CHIP8_ASSEMBLER_HPP
@@ -0,0 +1,121 @@
+#ifndef PASCAL_CHIP8_CODE_HPP
+#define PASCAL_CHIP8_CODE_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Pascal
+{
+	// CHIP-8 code as a stream of instruction records. The emitter builds
+	// it, the peephole optimizer rewrites it in place and the assembler
+	// encodes it; text is written only for listings.
+	namespace Chip8
+	{
+		enum class Op : uint8_t
+		{
+			CLS,		// cls
+			RET,		// ret
+			SYS,		// sys nnn, written as `break` for 0
+			JP,			// jp nnn
+			CALL,		// call nnn
+			SE_IMM,		// se vX, nn
+			SNE_IMM,	// sne vX, nn
+			SE,			// se vX, vY
+			LD_IMM,		// ld vX, nn
+			ADD_IMM,	// add vX, nn, vF is kept
+			LD,			// ld vX, vY
+			OR,			// or vX, vY
+			AND,		// and vX, vY
+			XOR,		// xor vX, vY
+			ADD,		// add vX, vY, vF is the carry
+			SUB,		// sub vX, vY, vF is 1 without a borrow
+			SHR,		// shr vX
+			SUBN,		// subn vX, vY
+			SHL,		// shl vX
+			SNE,		// sne vX, vY
+			LD_I,		// ld I, nnn
+			JP_V0,		// jp v0, nnn
+			RND,		// rnd vX, nn
+			DRW,		// drw vX, vY, n
+			SKP,		// skp vX
+			SKNP,		// sknp vX
+			LD_DT_TO,	// ld vX, DT
+			LD_KEY,		// ld vX, K
+			LD_DT,		// ld DT, vX
+			LD_ST,		// ld ST, vX
+			ADD_I,		// add I, vX
+			LD_F,		// ld F, vX
+			LD_B,		// ld B, vX
+			STORE,		// ld [I], vX: v0..vX to memory
+			LOAD,		// ld vX, [I]: memory to v0..vX
+			DATA,		// dw nnnn
+
+			// Not instructions
+			LABEL,		// names the address of the next instruction
+			COMMENT		// text of listings
+		};
+
+		const unsigned NoLabel = static_cast<unsigned>(-1);
+
+		struct Instr
+		{
+			Op op;
+
+			uint8_t x = 0;
+			uint8_t y = 0;
+
+			// nn, n, the data word, an address without a label or the
+			// offset added to the label
+			uint16_t imm = 0;
+
+			// Address of jumps, calls and ld I, the label LABEL defines, the
+			// text of COMMENT
+			unsigned label = NoLabel;
+		};
+
+		// Takes no space in the program
+		bool IsPseudo(Op op);
+
+		// Skips the next instruction on some condition
+		bool IsSkip(Op op);
+
+		class Code
+		{
+		public:
+			std::vector<Instr> instrs;
+
+			// Bytes of memory the program uses past its last instruction,
+			// not stored in the ROM
+			unsigned reserved = 0;
+
+			void add(Op op, unsigned x = 0, unsigned y = 0, unsigned imm = 0);
+
+			// Jumps, calls and ld I, to `offset` bytes past the label
+			void addAddress(Op op, std::string const& label, unsigned offset = 0);
+
+			void defineLabel(std::string const& name);
+			void addComment(std::string const& text);
+
+			// Number of the name, a new one for unknown names
+			unsigned label(std::string const& name);
+			// NoLabel for unknown names
+			unsigned findLabel(std::string const& name) const;
+
+			std::string const& labelName(unsigned label) const { return labels[label]; }
+			unsigned labelsCount() const { return static_cast<unsigned>(labels.size()); }
+
+			// Assembly in the syntax of the external assembler, in one pass
+			std::string toAssembly() const;
+
+		private:
+			std::vector<std::string> labels;
+			std::unordered_map<std::string, unsigned> labelNumbers;
+
+			std::vector<std::string> comments;
+		}; // class Code
+	} // namespace Chip8
+} // namespace Pascal
+
+#endif // PASCAL_CHIP8_CODE_HPP
@@ -0,0 +1,119 @@
+#ifndef PASCAL_CHIP8_EMITTER_HPP
+#define PASCAL_CHIP8_EMITTER_HPP
+
+#include <IR.hpp>
+#include <CallGraph.hpp>
+#include <Chip8Code.hpp>
+#include <FrameLayout.hpp>
+#include <RegisterAllocator.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Pascal
+{
+	// Writes CHIP-8 instruction records for an IR module.
+	//
+	// Virtual registers are placed by the register allocator. Instructions
+	// work on them in place; spilled ones are loaded to the fixed registers
+	// below and stored back.
+	//
+	//   v0, v1 - spilled first operand and result (low, high)
+	//   v2, v3 - spilled second operand, argument of intrinsics
+	//   v4..vB - allocated, kept by procedures
+	//   vC     - scratch for addressing and carries
+	//   vD     - bp
+	//   vE     - sp
+	//   vF     - flag
+	//
+	// A function that is never active twice at a time has a static frame
+	// at a fixed address, so it needs no bp and no sp. Static frames of
+	// functions that are never active together share memory. Recursive
+	// procedures keep bp-relative frames on the stack after them.
+	//
+	// The memory past the program is reserved for the static frames and,
+	// with recursion, the whole zone sp addresses. Recursion has no depth
+	// known in advance, so with `checkStack` every call of a recursive
+	// procedure first checks that the callee's frame fits into the zone,
+	// and stops at `break` otherwise.
+	class Chip8Emitter
+	{
+	public:
+		// One allocation per function of the module
+		Chip8Emitter(IR::Module const& module, std::vector<Allocation> const& allocations, bool checkStack = false);
+
+		Chip8::Code emit();
+
+		StackAddressing const& getStackAddressing() const { return stack; }
+
+	private:
+		IR::Module const& module;
+		std::vector<Allocation> const& allocations;
+		bool checkStack;
+		StackAddressing stack;
+		Chip8::Code code;
+
+		// Offset of the static frame past STACK_ZONE by function, -1 for
+		// frames on the stack
+		std::vector<int> staticFrames;
+		bool usesStack;
+
+		// Current function
+		const IR::Function* function;
+		const Allocation* allocation;
+		int staticFrame;
+		unsigned currentBlock;
+
+		// ARG instructions waiting for their call
+		std::vector<const IR::Instr*> pendingArgs;
+
+		struct Regs
+		{
+			unsigned lo;
+			unsigned hi;
+		};
+
+		void emitFunction(IR::Function const& function, Allocation const& allocation);
+		void emitInstr(IR::Instr const& instr);
+
+		void emitArithmetic(IR::Instr const& instr);
+		void emitBranch(IR::Instr const& instr);
+		void emitCall(IR::Instr const& instr);
+		void emitReturn();
+
+		// Registers holding the value, a spilled one is loaded to v0 and v1
+		Regs use(IR::VReg reg);
+		// Same, but spilled values go to v2 and v3 through v0 and v1
+		Regs useSecond(IR::VReg reg);
+		// Registers the value is computed to, v0 and v1 when spilled
+		Regs def(IR::VReg reg);
+		// Stores v0 and v1 back when the value is spilled
+		void finish(IR::VReg reg);
+
+		void move(unsigned to, unsigned from);
+		bool isWordReg(IR::VReg reg) const;
+
+		// Sets I to the address of a variable
+		void address(IR::Var var);
+
+		// Sets I to an offset in the frame of the current function
+		void frameAddress(unsigned offset);
+
+		std::string blockLabel(unsigned block) const;
+
+		// Units the whole stack needs if no procedure is active twice
+		static StackAddressing ChooseStackAddressing(std::vector<unsigned> const& frameSizes);
+
+		// Offsets of the static frames of non-recursive functions, the
+		// others get -1. A frame is placed past the frames of every static
+		// function that may call it. `size` is set to the bytes taken.
+		static std::vector<int> PlaceStaticFrames(CallGraph const& graph, std::vector<unsigned> const& frameSizes, unsigned& size);
+
+		// Bytes past STACK_ZONE where the stack may begin: the end of the
+		// static frames of functions active while a recursive one is. The
+		// stack overlaps the others.
+		static unsigned StackBase(CallGraph const& graph, std::vector<int> const& staticFrames, std::vector<unsigned> const& frameSizes);
+	}; // class Chip8Emitter
+} // namespace Pascal
+
+#endif // PASCAL_CHIP8_EMITTER_HPP
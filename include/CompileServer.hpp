@@ -0,0 +1,41 @@
+#ifndef PASCAL_COMPILE_SERVER_HPP
+#define PASCAL_COMPILE_SERVER_HPP
+
+#include <string>
+#include <vector>
+
+namespace Pascal
+{
+	// Resident compiler listening on a Unix domain socket. Process-wide
+	// state (keyword and type tables, allocator, file system caches) stays
+	// warm between requests.
+	//
+	// Every message is a sequence of fields, each field is a 32-bit little
+	// endian length followed by the bytes.
+	//     Request:  argc, args..., source file name, source
+	//     Response: exit status, diagnostics, generated code
+	// Source is sent by the client, so the server doesn't depend on the
+	// working directory of the client.
+	class CompileServer
+	{
+	public:
+		CompileServer(std::string const& socketPath);
+
+		// Serves requests one by one until a client sends '--shutdown'.
+		// Refuses to start when the socket path holds anything but a socket
+		// left by a server that is gone. Returns exit status.
+		int run();
+
+		// Forwards the command line to a running server, prints diagnostics
+		// and writes the output file. Returns exit status of the compilation.
+		static int RunClient(std::string const& socketPath, std::vector<std::string> const& args);
+
+	private:
+		std::string socketPath;
+
+		// Returns false on shutdown request
+		bool handle(int connection);
+	};
+} // namespace Pascal
+
+#endif // PASCAL_COMPILE_SERVER_HPP
@@ -0,0 +1,68 @@
+#ifndef PASCAL_CONSTANT_FOLDER_HPP
+#define PASCAL_CONSTANT_FOLDER_HPP
+
+#include <ASTForwards.hpp>
+#include <IR.hpp>
+#include <Symbol.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Pascal
+{
+	// Value of an expression made of literals, constants with a known value,
+	// + and -, computed in the width of `type` with the same wraparound as the
+	// generated code. Returns false if the expression isn't constant.
+	bool EvaluateConstant(const AST::ExpressionNode& expr, SymType type, uint16_t& value);
+
+	// Folds constant arithmetic of a function, in the width of every
+	// instruction:
+	//
+	//   - operations on constants become constants,
+	//   - constants are gathered over chains of + and -, (x + 1) - 3 is
+	//     computed as x + 254 in a byte,
+	//   - adding zero becomes a copy,
+	//   - a branch on a constant becomes a jump,
+	//   - a load of a variable a constant was stored to becomes the
+	//     constant. Stored constants are known to the rest of the block
+	//     and to a block whose only predecessor comes before it, calls
+	//     forget those of globals,
+	//   - values nothing reads are dropped.
+	//
+	// Runs on the IR as built and inlined, where every virtual register is
+	// written once, before any instruction reading it in block order.
+	class ConstantFolder
+	{
+	public:
+		void run(IR::Function& function);
+
+	private:
+		// Instruction writing every virtual register and its readers count
+		std::vector<IR::Instr*> defs;
+		std::vector<unsigned> uses;
+
+		// Constants stored to variables, by varKey(), with the stored width
+		typedef std::unordered_map<unsigned, IR::Instr const*> Stored;
+
+		static unsigned varKey(IR::Var var) { return var.slot * 2 + (var.isGlobal() ? 1 : 0); }
+
+		// Predecessors of every block
+		static std::vector<std::vector<unsigned>> Predecessors(IR::Function const& function);
+
+		void forward(IR::Instr& instr, Stored& stored);
+
+		void fold(IR::Instr& instr);
+
+		// Value of a register written by CONST
+		bool constantOf(IR::VReg reg, uint16_t& value) const;
+
+		// Constant that only `reg` reads, so it may be changed in place
+		IR::Instr* ownConstant(IR::VReg reg) const;
+
+		void makeConstant(IR::Instr& instr, uint16_t value);
+		void release(IR::VReg reg);
+	}; // class ConstantFolder
+} // namespace Pascal
+
+#endif // PASCAL_CONSTANT_FOLDER_HPP
@@ -0,0 +1,54 @@
+#ifndef PASCAL_DEAD_CODE_ELIMINATOR_HPP
+#define PASCAL_DEAD_CODE_ELIMINATOR_HPP
+
+#include <IR.hpp>
+
+#include <ostream>
+#include <vector>
+
+namespace Pascal
+{
+	// Removes what a program can't observe, on the whole module:
+	//
+	//   - blocks no path from the entry reaches,
+	//   - procedures no call from the main program reaches,
+	//   - stores of values read by nothing before the next store or the end
+	//     of the program, the code computing them,
+	//   - loads of a variable whose value the block already holds in a
+	//     register, and stores writing that value back. A store that only
+	//     a later load of the block read is then overwritten unread.
+	//   - globals and locals never read, with their storage.
+	//
+	// Procedures see the globals of their callees only, so a store before
+	// a call is kept if the callee may read it. The main program halts at
+	// its end, nothing is read after that.
+	class DeadCodeEliminator
+	{
+	public:
+		DeadCodeEliminator();
+
+		void run(IR::Module& module);
+
+		// `romSaved` is the difference of the sizes of the generated code
+		void printStats(std::ostream& out, unsigned romSaved) const;
+
+	private:
+		// Global slots each function may read, its callees included
+		std::vector<std::vector<bool>> globalReads;
+
+		unsigned blocksRemoved;
+		unsigned functionsRemoved;
+		unsigned storesRemoved;
+		unsigned globalsRemoved;
+		unsigned localsRemoved;
+
+		void removeUnreachableBlocks(IR::Function& function);
+		void removeUncalledFunctions(IR::Module& module);
+		void forwardStores(IR::Function& function);
+		void collectGlobalReads(IR::Module const& module);
+		void removeDeadStores(IR::Module const& module, IR::Function& function);
+		void removeUnreadStorage(IR::Module& module);
+	}; // class DeadCodeEliminator
+} // namespace Pascal
+
+#endif // PASCAL_DEAD_CODE_ELIMINATOR_HPP
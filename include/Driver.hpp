@@ -0,0 +1,62 @@
+#ifndef PASCAL_DRIVER_HPP
+#define PASCAL_DRIVER_HPP
+
+#include <ASTForwards.hpp>
+#include <Chip8Code.hpp>
+#include <IR.hpp>
+#include <ReportsManager.hpp>
+#include <TypeTable.hpp>
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Pascal
+{
+	class AnalysisCache;
+
+	// One compilation of a single program: scanning, parsing, analysis
+	// passes and code generation. Doesn't touch the file system except for
+	// the analysis cache, so it can be run by the compile server as well.
+	// All diagnostics state lives in the driver, so drivers on different
+	// threads are independent.
+	class Driver
+	{
+	public:
+		Driver(std::vector<std::string> const& args);
+
+		// Diagnostics are written to `diagnostics`. Returns exit status.
+		int compile(std::string const& fileName, std::shared_ptr<std::string> source,
+					std::ostream& diagnostics);
+
+		// ROM image, or the assembly with -S. Empty if there is none.
+		std::string const& getOutput() const;
+
+		static std::string GetInputFileName(std::vector<std::string> const& args);
+		static std::vector<std::string> GetInputFileNames(std::vector<std::string> const& args);
+
+		// Returns empty string if '-o' has no value
+		static std::string GetOutputFileName(std::vector<std::string> const& args);
+
+		// ".asm" for listings requested with '-S', ".ch8" for ROMs
+		static std::string GetOutputExtension(std::vector<std::string> const& args);
+
+	private:
+		std::vector<std::string> args;
+		std::string output;
+
+		ReportsContext reports;
+
+		// Referenced from the annotations of the tree
+		TypeTable types;
+
+		void runPasses(AST::ProgramNode const& tree, AnalysisCache* cache, std::ostream& diagnostics);
+
+		// Register allocation, emission and peephole. Reports go to
+		// `diagnostics` unless it is null.
+		Chip8::Code generate(IR::Module& module, std::ostream* diagnostics) const;
+	};
+} // namespace Pascal
+
+#endif // PASCAL_DRIVER_HPP
@@ -2,99 +2,193 @@
 #define PASCAL_ENVIRONMENT_HPP
 
 #include <string>
-#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <functional>
 #include <stdexcept>
-#include <memory>
+#include <cstdint>
 
 namespace Pascal
 {
+	// Symbol table for all nested scopes at once (scoped hashing). One open
+	// addressing table maps a name to its innermost visible definition, every
+	// definition remembers the one it shadows. Definitions are kept in the
+	// order they were made, so leaving a scope just pops the definitions made
+	// in it and restores the shadowed ones.
+	//
+	// Lookup is one probe sequence regardless of the nesting depth, leaving a
+	// scope is O(number of names defined in it). References to values stay
+	// valid until the scope of the value is left.
 	template <typename T>
 	class Environment
 	{
 	public:
 		Environment()
+			: m_Slots(InitialCapacity), m_SlotsUsed(0)
+		{ }
+
+		// Global scope has depth 0
+		void enterScope()
 		{
-			m_Enclosing = nullptr;
+			m_ScopeStarts.push_back(m_Entries.size());
 		}
 
-		Environment(std::shared_ptr<Environment<T>> enclocing)
-		{ 
-			m_Enclosing = enclocing;
+		// Leaving the global scope drops the global definitions, the
+		// environment is not used after that
+		void exitScope()
+		{
+			size_t start = 0;
+			if (!m_ScopeStarts.empty())
+			{
+				start = m_ScopeStarts.back();
+				m_ScopeStarts.pop_back();
+			}
+
+			while (m_Entries.size() > start)
+			{
+				Entry const& entry = m_Entries.back();
+				m_Slots[entry.slot].entry = entry.shadowed;
+				m_Entries.pop_back();
+			}
 		}
 
-		// return value - is new
-		bool define(std::string const& name, T obj)
+		unsigned getDepth() const
 		{
-			bool isNew = !m_Map.count(name);
-			m_Map.insert({ name, obj });
-			return isNew;
+			return static_cast<unsigned>(m_ScopeStarts.size());
 		}
 
-		T& lookup(std::string const& name)
+		// Defines in the current scope.
+		// return value - is new, existing definition is not replaced
+		bool define(std::string const& name, T obj)
 		{
-			if (m_Map.count(name))
+			size_t hash = hashOf(name);
+			size_t slot = findSlot(name, hash);
+			uint32_t previous = m_Slots[slot].entry;
+
+			if (previous != NoEntry && m_Entries[previous].depth == getDepth())
+				return false;
+
+			if (m_Slots[slot].name.empty())
 			{
-				return m_Map.at(name);
+				m_Slots[slot].name = name;
+				m_Slots[slot].hash = hash;
+				m_SlotsUsed++;
 			}
-			else throw std::out_of_range("Environment");
-		}
 
-		T& lookupAndAncestors(std::string const& name)
-		{
-			if (has(name)) return lookup(name);
-			if (m_Enclosing != nullptr) return m_Enclosing->lookupAndAncestors(name);
+			m_Entries.push_back({ std::move(obj), slot, previous, getDepth() });
+			m_Slots[slot].entry = static_cast<uint32_t>(m_Entries.size() - 1);
 
-			throw std::out_of_range("Environment");
+			// Growing moves slots, so `slot` is not used after that
+			if (m_SlotsUsed * 2 > m_Slots.size())
+				grow();
+
+			return true;
 		}
 
-		std::shared_ptr<Environment<T>> getEnclosing()
+		// Current scope only
+		T& lookup(std::string const& name)
 		{
-			return m_Enclosing;
+			Entry* entry = find(name);
+			if (entry == nullptr || entry->depth != getDepth()) throw std::out_of_range("Environment");
+
+			return entry->value;
 		}
 
-		Environment<T>* getAncestor(unsigned distance)
+		T& lookupAndAncestors(std::string const& name)
 		{
-			// TODO: mmm, shared_ptrs?
-			Environment<T>* current = this;
-			for (; distance > 0; distance--)
-			{
-				current = current->getEnclosing().get();
-			}
-			return current;
+			Entry* entry = find(name);
+			if (entry == nullptr) throw std::out_of_range("Environment");
+
+			return entry->value;
 		}
 
 		bool has(std::string const& name)
 		{
-			return m_Map.count(name);
+			Entry* entry = find(name);
+			return entry != nullptr && entry->depth == getDepth();
 		}
 
 		bool hasAndAncestors(std::string const& name)
 		{
-			if (has(name)) return true;
-			if (m_Enclosing != nullptr) return m_Enclosing->hasAndAncestors(name);
+			return find(name) != nullptr;
+		}
 
-			return false;
+	private:
+		static const uint32_t NoEntry = static_cast<uint32_t>(-1);
+		static const size_t InitialCapacity = 64;
+
+		// Once a name gets a slot it keeps it, even when it has no visible
+		// definition, so probe sequences are never broken by removal
+		struct Slot
+		{
+			std::string name;
+			size_t hash = 0;
+			uint32_t entry = NoEntry;
+		};
+
+		struct Entry
+		{
+			T value;
+			size_t slot;
+			uint32_t shadowed;
+			unsigned depth;
+		};
+
+		std::vector<Slot> m_Slots;
+		size_t m_SlotsUsed;
+
+		// Also the undo log: deque doesn't move values on push_back/pop_back
+		std::deque<Entry> m_Entries;
+		std::vector<size_t> m_ScopeStarts;
+
+		static size_t hashOf(std::string const& name)
+		{
+			return std::hash<std::string>()(name);
 		}
 
-		std::unordered_map<std::string, T> getMap()
+		// Slot of the name or the empty slot where it should be placed
+		size_t findSlot(std::string const& name, size_t hash)
 		{
-			return m_Map;
+			size_t mask = m_Slots.size() - 1;
+			size_t i = hash & mask;
+
+			while (!m_Slots[i].name.empty())
+			{
+				if (m_Slots[i].hash == hash && m_Slots[i].name == name) break;
+				i = (i + 1) & mask;
+			}
+
+			return i;
 		}
 
-		void defineBuiltins(T placeholder)
+		Entry* find(std::string const& name)
 		{
-			define("integer", placeholder);
-			define("long", placeholder);
-			define("make_bcd", placeholder);
-			define("debug_print_bcd", placeholder);
-			define("debug_print_bcd_high", placeholder);
-			define("cls", placeholder);
+			size_t slot = findSlot(name, hashOf(name));
+			uint32_t entry = m_Slots[slot].entry;
+
+			return entry == NoEntry ? nullptr : &m_Entries[entry];
 		}
 
-	private:
-		std::shared_ptr<Environment<T>> m_Enclosing;
-		std::unordered_map<std::string, T> m_Map;
+		void grow()
+		{
+			std::vector<Slot> old(m_Slots.size() * 2);
+			old.swap(m_Slots);
+
+			for (auto& slot : old)
+			{
+				if (slot.name.empty()) continue;
+
+				size_t i = findSlot(slot.name, slot.hash);
+				m_Slots[i].name = std::move(slot.name);
+				m_Slots[i].hash = slot.hash;
+				m_Slots[i].entry = slot.entry;
+
+				// All definitions of the name refer to the slot
+				for (uint32_t e = slot.entry; e != NoEntry; e = m_Entries[e].shadowed)
+					m_Entries[e].slot = i;
+			}
+		}
 	};
 }
 
-#endif // PASCAL_ENVIRONMENT_HPP
\ No newline at end of file
+#endif // PASCAL_ENVIRONMENT_HPP
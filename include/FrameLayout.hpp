@@ -0,0 +1,78 @@
+#ifndef PASCAL_FRAME_LAYOUT_HPP
+#define PASCAL_FRAME_LAYOUT_HPP
+
+#include <ASTForwards.hpp>
+#include <Chip8Code.hpp>
+#include <Symbol.hpp>
+
+#include <vector>
+
+namespace Pascal
+{
+	// Placement of the symbols of one scope in memory, computed once per
+	// procedure (or once for the globals). Symbols are addressed by the slot
+	// assigned by name resolution, so getting an offset is an array access.
+	class FrameLayout
+	{
+	public:
+		FrameLayout();
+
+		// Parameters, then local variables
+		static FrameLayout OfProcedure(const AST::ProcDeclNode& node);
+		static FrameLayout OfProcedure(const AST::FunctionDeclNode& node);
+
+		// Global variables. Procedures have slots too, but take no space.
+		static FrameLayout OfProgram(const AST::ProgramNode& node);
+
+		// Bytes taken by a value of the type
+		static unsigned SizeOf(SymType type);
+
+		// Places the next slot, returns its number
+		unsigned add(unsigned size);
+
+		unsigned offset(unsigned slot) const { return m_Offsets[slot]; }
+		unsigned sizeOf(unsigned slot) const { return m_Offsets[slot + 1] - m_Offsets[slot]; }
+
+		unsigned size() const { return m_Offsets.back(); }
+		unsigned count() const { return static_cast<unsigned>(m_Offsets.size() - 1); }
+
+	private:
+		// Offset of every slot and the total size at the end
+		std::vector<unsigned> m_Offsets;
+	};
+
+	// Stack pointer and base pointer are 8-bit registers, so they count the
+	// stack zone in units: 1 byte for zones up to 256 bytes, 2 bytes up to
+	// 512 and so on. Frames are rounded up to whole units.
+	//
+	// The stack begins `base` bytes past STACK_ZONE, static frames are
+	// placed before it.
+	class StackAddressing
+	{
+	public:
+		StackAddressing(unsigned unit = 1, unsigned base = 0);
+
+		// Smallest unit that covers the zone
+		static StackAddressing ForZoneSize(unsigned bytes);
+
+		unsigned getUnit() const { return unit; }
+		unsigned getBase() const { return base; }
+		unsigned zoneSize() const { return unit * 256; }
+
+		// Bytes rounded up to units, the value added to the stack pointer
+		unsigned units(unsigned bytes) const { return (bytes + unit - 1) / unit; }
+
+		// Sets I to STACK_ZONE + base + `baseReg` * unit + offset.
+		// `scratchReg` is changed when the offset is not zero.
+		void loadAddress(Chip8::Code& code, unsigned baseReg, unsigned offset, unsigned scratchReg) const;
+
+		// Adds a constant of any size to I, by steps of at most 255
+		static void AddToI(Chip8::Code& code, unsigned offset, unsigned scratchReg);
+
+	private:
+		unsigned unit;
+		unsigned base;
+	};
+} // namespace Pascal
+
+#endif // PASCAL_FRAME_LAYOUT_HPP
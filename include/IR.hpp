@@ -0,0 +1,141 @@
+#ifndef PASCAL_IR_HPP
+#define PASCAL_IR_HPP
+
+#include <FrameLayout.hpp>
+#include <Symbol.hpp>
+#include <TypeTable.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Pascal
+{
+	// Linear three-address code between the AST and the machine code. Every
+	// value is a virtual register of an explicit width, every instruction
+	// reads at most two registers and writes at most one. Control flow is
+	// explicit: a function is a list of basic blocks, each one ends with a
+	// single terminator.
+	namespace IR
+	{
+		enum class Width : uint8_t
+		{
+			BYTE = 1,
+			WORD = 2
+		};
+
+		// Width of variables of the type
+		Width WidthOf(SymType type);
+
+		typedef unsigned VReg;
+		const VReg NoReg = static_cast<VReg>(-1);
+
+		enum class Opcode : uint8_t
+		{
+			CONST,		// dst = imm
+			COPY,		// dst = a
+			ADD,		// dst = a + b
+			SUB,		// dst = a - b
+			NEG,		// dst = -a
+			EXTEND,		// dst = a zero-extended to a word
+			TRUNC,		// dst = low byte of a
+			LOAD,		// dst = var
+			STORE,		// var = a
+			ARG,		// argument `index` of the next call is a
+			CALL,		// call function `target`
+			INTRINSIC,	// call Intrinsics[target]
+
+			// Terminators
+			JUMP,		// goto target
+			BRANCH,		// if a != 0 goto target else goto elseTarget
+			RET
+		};
+
+		bool IsTerminator(Opcode op);
+
+		// Computes its result and does nothing else
+		bool IsPure(Opcode op);
+
+		// Variable in memory: a global by its slot or a slot of the frame
+		struct Var
+		{
+			StorageClass storage = StorageClass::NONE;
+			unsigned slot = 0;
+
+			bool isGlobal() const { return storage == StorageClass::GLOBAL; }
+		};
+
+		struct Instr
+		{
+			Opcode op;
+
+			// Width of the result, of the stored value for STORE and ARG
+			Width width = Width::BYTE;
+
+			VReg dst = NoReg;
+			VReg a = NoReg;
+			VReg b = NoReg;
+
+			uint16_t imm = 0;
+			Var var;
+
+			// Block, function or intrinsic, depending on the opcode
+			unsigned target = 0;
+			unsigned elseTarget = 0;
+			unsigned index = 0;
+		};
+
+		struct BasicBlock
+		{
+			std::vector<Instr> instrs;
+
+			Instr const& terminator() const { return instrs.back(); }
+		};
+
+		struct Function
+		{
+			std::string name;
+			// Of the name in the source, for diagnostics
+			size_t pos = 0;
+
+			// Null for the main program
+			const Signature* signature = nullptr;
+
+			// Parameters and locals. The main program keeps its globals
+			// in the module, its frame holds only temporaries.
+			FrameLayout frame;
+
+			// Entry is the first block
+			std::vector<BasicBlock> blocks;
+
+			// Width of every virtual register
+			std::vector<Width> vregs;
+
+			VReg newVReg(Width width);
+			bool isMain() const { return signature == nullptr; }
+		};
+
+		// Drops pure instructions whose result nothing reads, along with
+		// the values only they read
+		void RemoveDeadValues(Function& function);
+
+		struct Module
+		{
+			std::string name;
+
+			// Main program is the first function
+			std::vector<Function> functions;
+
+			// Names and layout of the globals, by slot. Procedures take
+			// slots too, with no space.
+			std::vector<std::string> globalNames;
+			FrameLayout globals;
+		};
+
+		// Readable listing, for -fdump-ir
+		void Print(std::ostream& out, Module const& module);
+	} // namespace IR
+} // namespace Pascal
+
+#endif // PASCAL_IR_HPP
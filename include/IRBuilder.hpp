@@ -0,0 +1,144 @@
+#ifndef PASCAL_IR_BUILDER_HPP
+#define PASCAL_IR_BUILDER_HPP
+
+#include <Visitor.hpp>
+#include <IR.hpp>
+#include <TreeWalker.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace Pascal
+{
+	// Lowers the resolved tree to IR. Expressions are evaluated in the width
+	// of the value they are assigned or passed to, like the CHIP-8 code did
+	// before; conditions are evaluated as words. Operands needing more
+	// registers are evaluated first, so fewer values are live at once.
+	//
+	// Runs after name resolution and semantic checks, only on trees without
+	// errors. Nothing is lowered by recursion, so programs can be
+	// arbitrarily deep. Statements are taken from an explicit stack: compound
+	// statements and ifs push their parts instead of visiting them.
+	// Expressions are lowered on TreeWalker: the visit methods of expression
+	// nodes are its post-order callback.
+	class IRBuilder : public AST::Visitor
+	{
+	public:
+		IRBuilder();
+		~IRBuilder();
+
+		IR::Module build(const AST::ProgramNode& tree);
+
+		void visitProgramNode(const AST::ProgramNode& node);
+		void visitCompoundNode(const AST::CompoundNode& node);
+		void visitVarDeclNode(const AST::VarDeclNode& node);
+		void visitTypeNode(const AST::TypeNode& node);
+		void visitProcDeclNode(const AST::ProcDeclNode& node);
+		void visitAssignmentNode(const AST::AssignmentNode& node);
+		void visitVarNode(const AST::VarNode& node);
+		void visitIntLiteralNode(const AST::IntLiteralNode& node);
+		void visitBinaryExprNode(const AST::BinaryExprNode& node);
+		void visitUnaryExprNode(const AST::UnaryExprNode& node);
+		void visitProcCallNode(const AST::CallStmtNode& node);
+		void visitFunctionDeclNode(const AST::FunctionDeclNode& node);
+		void visitIfNode(const AST::IfNode& node);
+		void visitFunctionCall(const AST::FunctionCallNode& node);
+
+	private:
+		IR::Module module;
+
+		IR::Function* function;
+		unsigned block;
+
+		// Function of every global slot, -1 for variables
+		std::vector<int> functionOfSlot;
+
+		// Requested width of the expression being lowered, all of its
+		// operands are lowered in it
+		IR::Width width;
+
+		// Values of the operands lowered so far
+		std::vector<IR::VReg> values;
+
+		// Registers every node of the expression takes to evaluate
+		std::unordered_map<const AST::ExpressionNode*, unsigned> needs;
+
+		// Terminator whose target is set later. Blocks grow while the
+		// target is lowered, so it is kept by position.
+		struct Jump
+		{
+			unsigned block;
+			size_t instr;
+		};
+
+		// Statement to lower or, without one, the end of an arm of `ifNode`
+		struct Step
+		{
+			const AST::StmtNode* stmt;
+			const AST::IfNode* ifNode;
+			bool elseArm;
+			Jump branch;
+			Jump thenEnd;
+			unsigned thenBlock;
+			unsigned elseBlock;
+		};
+
+		// Statements left to lower, the next one last
+		std::vector<Step> steps;
+
+		void lowerStatement(const AST::StmtNode& stmt);
+		void endArm(Step step);
+
+		IR::VReg lower(const AST::ExpressionNode& expr, IR::Width width);
+		IR::VReg convert(IR::VReg value, IR::Width to);
+
+		// Operand needing more registers first, see visitBinaryExprNode
+		bool rightFirst(const AST::BinaryExprNode& node) const;
+
+		// Appends to the current block
+		IR::Instr& emit(IR::Opcode op, IR::Width width);
+		IR::VReg emitValue(IR::Opcode op, IR::Width width, IR::VReg a = IR::NoReg, IR::VReg b = IR::NoReg);
+
+		unsigned newBlock();
+
+		Jump lastJump() const;
+		IR::Instr& jumpAt(Jump jump);
+
+		static IR::Var varOf(SymbolRef const& symbol);
+
+		// Post-order callback filling `needs`
+		class RegisterCount : public EmptyVisitor
+		{
+		public:
+			RegisterCount(IRBuilder* owner);
+
+			void visitVarNode(const AST::VarNode& node);
+			void visitIntLiteralNode(const AST::IntLiteralNode& node);
+			void visitBinaryExprNode(const AST::BinaryExprNode& node);
+			void visitUnaryExprNode(const AST::UnaryExprNode& node);
+			void visitFunctionCall(const AST::FunctionCallNode& node);
+
+		private:
+			IRBuilder* owner;
+		};
+
+		// Pre-order callback choosing the order of the operands
+		class OperandOrder : public EmptyVisitor
+		{
+		public:
+			OperandOrder(IRBuilder* owner);
+
+			void visitBinaryExprNode(const AST::BinaryExprNode& node);
+
+		private:
+			IRBuilder* owner;
+		};
+
+		RegisterCount registerCount;
+		OperandOrder operandOrder;
+		TreeWalker counter;
+		TreeWalker walker;
+	}; // class IRBuilder
+} // namespace Pascal
+
+#endif // PASCAL_IR_BUILDER_HPP
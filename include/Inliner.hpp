@@ -0,0 +1,77 @@
+#ifndef PASCAL_INLINER_HPP
+#define PASCAL_INLINER_HPP
+
+#include <IR.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace Pascal
+{
+	// Replaces calls with the body of the procedure called, on the whole
+	// module, where an estimate of the CHIP-8 code says it pays off.
+	//
+	// A call costs the stores of the arguments to the stack, `call`, the
+	// prologue pushing bp and saving registers, the loads of the parameters
+	// and the epilogue restoring all that. An inlined body costs its own
+	// code at every call site instead, and the procedure goes away once no
+	// call is left.
+	//
+	//   - SPEED inlines procedures up to a few times the size of the call
+	//     overhead, and any procedure called once, while the estimated
+	//     program fits into a part of the memory,
+	//   - SIZE inlines only where the program gets smaller.
+	//
+	// Parameters and locals of the callee get slots in the caller's frame,
+	// shared by all inlined calls of one procedure. Parameters the callee
+	// never assigns read the argument value directly. Recursive procedures
+	// and procedures calling them are never inlined.
+	class Inliner
+	{
+	public:
+		enum class Goal
+		{
+			SPEED,
+			SIZE
+		};
+
+		Inliner(Goal goal);
+
+		void run(IR::Module& module);
+
+		void printStats(std::ostream& out) const;
+
+		// Estimated CHIP-8 instructions of the body of a function, without
+		// the prologue and the epilogue
+		static unsigned BodyCost(IR::Function const& function);
+
+	private:
+		Goal goal;
+
+		// By function
+		std::vector<unsigned> costs;
+		std::vector<unsigned> callSites;
+		std::vector<bool> inlinable;
+
+		// Estimated instructions of the whole program
+		unsigned moduleCost;
+
+		unsigned inlined;
+		uint64_t cyclesSaved;
+		int romGrowth;
+
+		// Functions with their callees first. Recursive ones and their
+		// callers are last, they are never inlined.
+		std::vector<unsigned> bottomUpOrder(IR::Module const& module);
+
+		// Growth of the program in instructions if the next call of the
+		// callee is inlined, negative when it shrinks
+		int growthOf(IR::Module const& module, unsigned callee) const;
+		bool shouldInline(IR::Module const& module, unsigned callee) const;
+
+		void inlineCalls(IR::Module& module, unsigned caller);
+	}; // class Inliner
+} // namespace Pascal
+
+#endif // PASCAL_INLINER_HPP
@@ -0,0 +1,74 @@
+#ifndef PASCAL_INTRINSICS_HPP
+#define PASCAL_INTRINSICS_HPP
+
+#include <Chip8Code.hpp>
+#include <Symbol.hpp>
+
+namespace Pascal
+{
+	const unsigned MaxIntrinsicParams = 2;
+
+	// Builtin procedure, implemented by the code generator. Arguments are
+	// evaluated into the accumulator (v2, v3) before `emit` is called.
+	struct Intrinsic
+	{
+		const char* name;
+		unsigned arity;
+		SymType params[MaxIntrinsicParams];
+
+		// Estimated CHIP-8 cycles of the emitted code, without arguments
+		unsigned cycles;
+
+		void (*emit)(Chip8::Code& code);
+	};
+
+	namespace IntrinsicCode
+	{
+		void cls(Chip8::Code& code);
+		void makeBcd(Chip8::Code& code);
+		void debugPrintBcd(Chip8::Code& code);
+		void debugPrintBcdHigh(Chip8::Code& code);
+		void breakpoint(Chip8::Code& code);
+	}
+
+	// Name resolution stores the index in SymbolRef::slot of builtins, so
+	// later passes index this table instead of comparing names.
+	constexpr Intrinsic Intrinsics[] =
+	{
+		{ "cls", 0, {}, 1, IntrinsicCode::cls },
+		{ "make_bcd", 1, { SymType::LONG }, 4, IntrinsicCode::makeBcd },
+		{ "debug_print_bcd", 0, {}, 12, IntrinsicCode::debugPrintBcd },
+		{ "debug_print_bcd_high", 0, {}, 12, IntrinsicCode::debugPrintBcdHigh },
+		{ "break", 0, {}, 1, IntrinsicCode::breakpoint }
+	};
+
+	constexpr unsigned IntrinsicsCount = sizeof(Intrinsics) / sizeof(Intrinsics[0]);
+
+	namespace detail
+	{
+		constexpr bool namesEqual(const char* a, const char* b)
+		{
+			while (*a != '\0' && *a == *b)
+			{
+				a++;
+				b++;
+			}
+			return *a == *b;
+		}
+	}
+
+	// Index in Intrinsics or -1
+	constexpr int FindIntrinsic(const char* name)
+	{
+		for (unsigned i = 0; i < IntrinsicsCount; i++)
+		{
+			if (detail::namesEqual(Intrinsics[i].name, name))
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	static_assert(FindIntrinsic("make_bcd") == 1, "Intrinsics table is not usable at compile time");
+} // namespace Pascal
+
+#endif // PASCAL_INTRINSICS_HPP
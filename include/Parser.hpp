@@ -2,6 +2,7 @@
 #define PASCAL_PARSER_HPP_DEFINED
 
 #include <memory>
+#include <vector>
 
 #include <Token.hpp>
 #include <AST.hpp>
@@ -21,15 +22,32 @@ namespace Pascal
         std::unique_ptr<AST::TypeNode> parseType();
         std::unique_ptr<AST::ProcDeclNode> parseProcDecl();
         std::unique_ptr<AST::CompoundNode> parseCompound();
-        std::unique_ptr<AST::StmtNode> parseStmt();
         std::unique_ptr<AST::AssignmentNode> parseAssignment();
         std::unique_ptr<AST::CallStmtNode> parseProcCall();
-        std::unique_ptr<AST::IfNode> parseIf();
         std::unique_ptr<AST::ExpressionNode> parseExpression();
-        std::unique_ptr<AST::ExpressionNode> parseFactor();
         std::unique_ptr<AST::ExpressionNode> parseUnary();
         std::unique_ptr<AST::ExpressionNode> parsePrimary();
 
+        // Statement whose parts are being parsed. Nested compound and if
+        // statements are kept in a stack of these instead of recursion, so
+        // the nesting depth doesn't use the native stack.
+        struct OpenStmt
+        {
+            enum Kind
+            {
+                COMPOUND,
+                THEN_ARM,
+                ELSE_ARM
+            } kind;
+
+            std::vector<std::unique_ptr<AST::StmtNode>> stmts;
+            std::unique_ptr<AST::ExpressionNode> condition;
+            std::unique_ptr<AST::StmtNode> thenArm;
+        };
+
+        // Releases the parts parsed so far without recursion
+        static void discard(OpenStmt& stmt);
+
         TokenList m_Tokens;
         size_t m_ParserPos;
 
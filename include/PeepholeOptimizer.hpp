@@ -0,0 +1,127 @@
+#ifndef PASCAL_PEEPHOLE_OPTIMIZER_HPP
+#define PASCAL_PEEPHOLE_OPTIMIZER_HPP
+
+#include <Chip8Code.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Pascal
+{
+	// Pattern-driven cleanup of the emitted code, run until nothing
+	// changes:
+	//
+	//   - self-moves and adds of zero are dropped,
+	//   - adjacent immediate loads and adds to one register are merged,
+	//     pairs that cancel out are dropped,
+	//   - a move straight back is dropped,
+	//   - loads of a constant a register already holds are dropped,
+	//   - registers are read from the register they were copied from,
+	//     writes nothing reads on any path are dropped,
+	//   - I is not recomputed while it holds the same address,
+	//   - a value just stored is not loaded back from the same address,
+	//   - jumps to the next instruction are dropped.
+	//
+	// The state of registers is tracked only between labels, while their
+	// liveness follows the jumps. An instruction after a skip is never
+	// changed. Range loads and stores may move I on some interpreters, so
+	// I is unknown after them.
+	class PeepholeOptimizer
+	{
+	public:
+		// Labels of the functions, the entry first. Used to estimate how
+		// often every instruction runs.
+		PeepholeOptimizer(std::vector<std::string> const& functions);
+
+		// Rewrites the instructions in place
+		void run(Chip8::Code& code);
+
+		unsigned getRemoved() const { return removed; }
+		uint64_t getCyclesSaved() const { return cyclesSaved; }
+
+		void printStats(std::ostream& out) const;
+
+	private:
+		struct Line
+		{
+			Chip8::Instr instr;
+
+			unsigned function = 0;
+			bool removed = false;
+		};
+
+		// Address in I: a label plus registers (by their version) plus a
+		// constant
+		struct Address
+		{
+			unsigned label = Chip8::NoLabel;
+			std::vector<std::pair<unsigned, unsigned>> regs;
+			unsigned offset = 0;
+
+			bool operator==(Address const& other) const;
+		};
+
+		struct State
+		{
+			int known[16];
+			unsigned versions[16];
+
+			// Register each one was copied from and its version then
+			int copyOf[16];
+			unsigned copyVersions[16];
+
+			bool iKnown;
+			Address i;
+
+			// Last range store, its address and the registers stored
+			bool stored;
+			Address storeAddress;
+			unsigned storeVersions[16];
+			unsigned storeCount;
+
+			void reset();
+			void write(unsigned reg, int value = -1);
+		};
+
+		std::vector<std::string> functions;
+		std::vector<Line> lines;
+
+		// How often each function runs at most
+		std::vector<uint64_t> executions;
+
+		unsigned removed;
+		uint64_t cyclesSaved;
+
+		// Function of every label, -1 for the others
+		std::vector<int> functionOf;
+
+		void load(Chip8::Code const& code);
+		void estimateExecutions();
+
+		bool matchPairs();
+		bool propagate();
+		bool removeDeadWrites();
+
+		// Registers read on some path after the line, given the registers
+		// read from every line on
+		unsigned liveOut(size_t line, std::vector<unsigned> const& liveIn,
+			std::vector<size_t> const& labelLines) const;
+
+		// Registers read and written by an instruction, as bit masks.
+		// Returns false if it does anything else.
+		static bool effects(Chip8::Instr const& instr, unsigned& uses, unsigned& defs);
+
+		// Effect of an instruction on the tracked state
+		void apply(State& state, Chip8::Instr const& instr, bool conditional) const;
+
+		void remove(size_t line);
+
+		// Next line that is still there, lines.size() if there is none
+		size_t next(size_t line) const;
+	}; // class PeepholeOptimizer
+} // namespace Pascal
+
+#endif // PASCAL_PEEPHOLE_OPTIMIZER_HPP
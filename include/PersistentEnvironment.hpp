@@ -0,0 +1,233 @@
+#ifndef PASCAL_PERSISTENT_ENVIRONMENT_HPP
+#define PASCAL_PERSISTENT_ENVIRONMENT_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <bitset>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+
+namespace Pascal
+{
+	// Immutable variant of Environment. Names are kept in a hash array mapped
+	// trie whose nodes are never modified: defining a name copies the path to
+	// it (O(log n)) and shares the rest with the previous state. Copying the
+	// environment is a snapshot, it costs O(1) and later definitions don't
+	// affect it, so analysis can be restarted from the state at any
+	// declaration.
+	//
+	// Like in Environment, the trie maps a name to its innermost visible
+	// definition. Entering a scope keeps a snapshot of the enclosing one,
+	// leaving the scope returns to it.
+	//
+	// `Hash` is replaceable, so tests can make names collide.
+	template <typename T, typename Hash = std::hash<std::string>>
+	class PersistentEnvironment
+	{
+	public:
+		PersistentEnvironment()
+			: m_Depth(0), m_Size(0)
+		{ }
+
+		void enterScope()
+		{
+			m_Enclosing = std::make_shared<const PersistentEnvironment>(*this);
+			m_Depth++;
+		}
+
+		// Leaving the global scope drops the global definitions
+		void exitScope()
+		{
+			if (m_Enclosing)
+			{
+				// Copied first, assigning releases the enclosing state
+				PersistentEnvironment enclosing = *m_Enclosing;
+				*this = enclosing;
+			}
+			else
+			{
+				*this = PersistentEnvironment();
+			}
+		}
+
+		unsigned getDepth() const
+		{
+			return m_Depth;
+		}
+
+		// Number of visible names
+		size_t size() const
+		{
+			return m_Size;
+		}
+
+		// Defines in the current scope.
+		// return value - is new, existing definition is not replaced
+		bool define(std::string const& name, T obj)
+		{
+			size_t hash = hashOf(name);
+			const Binding* previous = find(m_Root.get(), hash, name);
+
+			if (previous != nullptr && previous->depth == m_Depth)
+				return false;
+
+			if (previous == nullptr) m_Size++;
+
+			m_Root = insert(m_Root, 0, hash, Binding{ name, std::move(obj), m_Depth });
+			return true;
+		}
+
+		// Current scope only
+		T const& lookup(std::string const& name) const
+		{
+			const Binding* binding = find(m_Root.get(), hashOf(name), name);
+			if (binding == nullptr || binding->depth != m_Depth) throw std::out_of_range("PersistentEnvironment");
+
+			return binding->value;
+		}
+
+		T const& lookupAndAncestors(std::string const& name) const
+		{
+			const Binding* binding = find(m_Root.get(), hashOf(name), name);
+			if (binding == nullptr) throw std::out_of_range("PersistentEnvironment");
+
+			return binding->value;
+		}
+
+		bool has(std::string const& name) const
+		{
+			const Binding* binding = find(m_Root.get(), hashOf(name), name);
+			return binding != nullptr && binding->depth == m_Depth;
+		}
+
+		bool hasAndAncestors(std::string const& name) const
+		{
+			return find(m_Root.get(), hashOf(name), name) != nullptr;
+		}
+
+	private:
+		static const unsigned BitsPerLevel = 5;
+		static const size_t LevelMask = (1 << BitsPerLevel) - 1;
+
+		struct Binding
+		{
+			std::string name;
+			T value;
+			unsigned depth;
+		};
+
+		struct Node;
+		typedef std::shared_ptr<const Node> NodePtr;
+
+		// Either a branch with a child for every set bit of `bitmap`, or a
+		// leaf with the bindings of names that have the same hash
+		struct Node
+		{
+			uint32_t bitmap = 0;
+			std::vector<NodePtr> children;
+
+			size_t hash = 0;
+			std::vector<Binding> bindings;
+
+			bool isLeaf() const { return !bindings.empty(); }
+		};
+
+		NodePtr m_Root;
+		std::shared_ptr<const PersistentEnvironment> m_Enclosing;
+		unsigned m_Depth;
+		size_t m_Size;
+
+		static size_t hashOf(std::string const& name)
+		{
+			return Hash()(name);
+		}
+
+		static unsigned childIndex(uint32_t bitmap, uint32_t bit)
+		{
+			return static_cast<unsigned>(std::bitset<32>(bitmap & (bit - 1)).count());
+		}
+
+		static const Binding* find(const Node* node, size_t hash, std::string const& name)
+		{
+			for (unsigned shift = 0; node != nullptr; shift += BitsPerLevel)
+			{
+				if (node->isLeaf())
+				{
+					if (node->hash != hash) return nullptr;
+
+					for (auto const& binding : node->bindings)
+					{
+						if (binding.name == name) return &binding;
+					}
+					return nullptr;
+				}
+
+				uint32_t bit = 1u << ((hash >> shift) & LevelMask);
+				if ((node->bitmap & bit) == 0) return nullptr;
+
+				node = node->children[childIndex(node->bitmap, bit)].get();
+			}
+
+			return nullptr;
+		}
+
+		// Returns the new version of `node` with the binding added or replaced
+		static NodePtr insert(NodePtr const& node, unsigned shift, size_t hash, Binding binding)
+		{
+			if (node == nullptr)
+			{
+				auto leaf = std::make_shared<Node>();
+				leaf->hash = hash;
+				leaf->bindings.push_back(std::move(binding));
+				return leaf;
+			}
+
+			if (node->isLeaf())
+			{
+				if (node->hash == hash)
+				{
+					auto leaf = std::make_shared<Node>(*node);
+					for (auto& existing : leaf->bindings)
+					{
+						if (existing.name == binding.name)
+						{
+							existing = std::move(binding);
+							return leaf;
+						}
+					}
+
+					leaf->bindings.push_back(std::move(binding));
+					return leaf;
+				}
+
+				// Hashes differ at this level or deeper, the leaf moves down
+				// under a new branch
+				auto branch = std::make_shared<Node>();
+				branch->bitmap = 1u << ((node->hash >> shift) & LevelMask);
+				branch->children.push_back(node);
+				return insert(branch, shift, hash, std::move(binding));
+			}
+
+			uint32_t bit = 1u << ((hash >> shift) & LevelMask);
+			unsigned index = childIndex(node->bitmap, bit);
+
+			auto branch = std::make_shared<Node>(*node);
+			if (node->bitmap & bit)
+			{
+				branch->children[index] = insert(node->children[index], shift + BitsPerLevel, hash, std::move(binding));
+			}
+			else
+			{
+				branch->bitmap |= bit;
+				branch->children.insert(branch->children.begin() + index,
+					insert(nullptr, shift + BitsPerLevel, hash, std::move(binding)));
+			}
+
+			return branch;
+		}
+	};
+}
+
+#endif // PASCAL_PERSISTENT_ENVIRONMENT_HPP
@@ -0,0 +1,82 @@
+#ifndef PASCAL_REGISTER_ALLOCATOR_HPP
+#define PASCAL_REGISTER_ALLOCATOR_HPP
+
+#include <IR.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Pascal
+{
+	// Place of a virtual register for its whole live range: one register
+	// (two for words) or a frame offset.
+	struct Location
+	{
+		static const uint8_t NoRegister = 0xFF;
+
+		uint8_t lo = NoRegister;
+		uint8_t hi = NoRegister;
+		unsigned offset = 0;
+
+		bool inRegister() const { return lo != NoRegister; }
+	};
+
+	struct Allocation
+	{
+		// By virtual register
+		std::vector<Location> locations;
+
+		// Highest register used, 0 if there is none. Procedures save
+		// v0 up to it, CHIP-8 only stores and loads register ranges.
+		unsigned lastRegister = 0;
+		unsigned saveOffset = 0;
+
+		// Parameters, locals, spill slots and saved registers
+		unsigned frameSize = 0;
+
+		bool savesRegisters() const { return lastRegister != 0; }
+	};
+
+	// Linear-scan allocation of v4..vB over the live ranges of a function.
+	//
+	// Locals and parameters become virtual registers first, so they are
+	// allocated like temporaries; a spilled one stays in its frame slot.
+	// Ranges are the hull of the positions where a register is live, in
+	// block order. Under pressure the range with the fewest uses per
+	// instruction covered is spilled.
+	//
+	// Procedures keep the registers they use, so values live across calls
+	// need no special care.
+	class RegisterAllocator
+	{
+	public:
+		static const unsigned FirstRegister = 0x4;
+		static const unsigned LastRegister = 0xB;
+
+		// Rewrites locals of the function to virtual registers
+		Allocation allocate(IR::Function& function);
+
+		// Every virtual register in its own frame slot, for -fno-regalloc
+		static Allocation SpillAll(IR::Function const& function);
+
+	private:
+		struct Range
+		{
+			IR::VReg reg;
+			unsigned start;
+			unsigned end;
+			unsigned uses;
+
+			float weight() const { return static_cast<float>(uses) / (end - start + 1); }
+		};
+
+		// Frame offset a register is spilled to, by virtual register; -1
+		// if it needs a slot of its own
+		std::vector<int> homes;
+
+		void promoteLocals(IR::Function& function);
+		std::vector<Range> buildRanges(IR::Function const& function) const;
+	}; // class RegisterAllocator
+} // namespace Pascal
+
+#endif // PASCAL_REGISTER_ALLOCATOR_HPP
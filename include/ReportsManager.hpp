@@ -1,8 +1,14 @@
 #ifndef PASCAL_INTERNAL_HPP
 #define PASCAL_INTERNAL_HPP
 
+#include <atomic>
+#include <bitset>
+#include <cstdint>
 #include <memory>
+#include <ostream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace Pascal
@@ -35,16 +41,164 @@ namespace Pascal
 		UNKNOWN_ESCAPE_CHAR
 	};
 
+	// Must follow the last members of the enums above
+	const size_t ErrorTypesCount = static_cast<size_t>(ErrorType::ILLEGAL_CHAR) + 1;
+	const size_t WarningTypesCount = static_cast<size_t>(WarningType::UNKNOWN_ESCAPE_CHAR) + 1;
+
 	typedef struct
 	{
 		std::string fileName;
 		std::shared_ptr<const std::string> source;
 	} ReportFile;
 
+	enum class ReportType
+	{
+		WARNING,
+		ERROR,
+		NOTE
+	};
+
+	enum class DiagnosticsFormat
+	{
+		// Human readable, with source snippet
+		TEXT,
+		// One JSON object per line
+		JSON,
+		// Single SARIF 2.1.0 log per compilation
+		SARIF
+	};
+
+	// Gets every report of enabled type before it is printed, including
+	// duplicates and reports over the limits.
+	class ReportListener
+	{
+	public:
+		virtual ~ReportListener() {}
+
+		virtual void onReport(size_t where, ReportType type, std::string const& msg) = 0;
+	};
+
+	// Reports made by one thread in one compilation. Only the owning thread
+	// appends to it, so no locking is needed.
+	class ReportBuffer
+	{
+	private:
+		friend class ReportsManager;
+		friend class ReportsContext;
+
+		struct Record
+		{
+			size_t where;
+			ReportType type;
+			std::string msg;
+		};
+
+		std::thread::id owner;
+		std::vector<Record> records;
+
+		// Position of a report -> indices of records made there
+		std::unordered_multimap<size_t, size_t> recordsAt;
+
+		// Last report wasn't recorded, so its notes aren't either
+		bool dropping;
+
+		ReportBuffer* next;
+	};
+
+	// Diagnostics engine of a single compilation. Any number of threads can
+	// report into it (after SetContext()): every thread gets its own buffer,
+	// counters are atomic. Reports are printed by ReportsManager::Flush(),
+	// ordered by position in the source, so the output doesn't depend on
+	// thread scheduling.
+	class ReportsContext
+	{
+	public:
+		ReportsContext();
+		~ReportsContext();
+
+		ReportsContext(ReportsContext const&) = delete;
+		ReportsContext& operator=(ReportsContext const&) = delete;
+
+	private:
+		friend class ReportsManager;
+
+		std::vector<ReportFile> includeStack;
+
+		ReportFile currentFile;
+		
+		std::bitset<ErrorTypesCount> disallowedErrors;
+		std::bitset<WarningTypesCount> disallowedWarnings;
+
+		std::atomic<unsigned> warningsCount;
+		std::atomic<unsigned> errorsCount;
+
+		// Zero means no limit
+		unsigned maxErrors;
+		unsigned categoryLimit;
+
+		std::atomic<unsigned> errorsByType[ErrorTypesCount];
+		std::atomic<unsigned> warningsByType[WarningTypesCount];
+
+		// Reports dropped by the category limit
+		std::atomic<unsigned> suppressedCount;
+		// Errors hidden by -Eno-<name>
+		std::atomic<unsigned> hiddenCount;
+		std::atomic<bool> maxErrorsReached;
+
+		bool treatWarningsAsError;
+
+		DiagnosticsFormat format;
+
+		ReportListener* listener;
+
+		std::ostream* output;
+
+		// Lock-free list, new buffers are pushed to the head
+		std::atomic<ReportBuffer*> buffers;
+
+		// Unique for every context ever created, used to find buffer of
+		// the current thread without looking through the list
+		uint64_t id;
+
+		ReportBuffer& threadBuffer();
+		void clearBuffers();
+	};
+
+	// Works on the context set for the current thread, so compilations on
+	// different threads don't share any state. Threads that haven't set a
+	// context get their own default one.
 	class ReportsManager
 	{
 	public:
+		static void SetContext(ReportsContext* context);
+		static ReportsContext* GetContext();
+
+		// Options:
+		//   -Wall, -Eall                 enable all warnings/errors
+		//   -W<name>, -Wno-<name>        enable/disable a warning
+		//   -E<name>, -Eno-<name>        show/hide an error, a hidden
+		//                                error still fails the compilation
+		//   -Werror
+		//   -fmax-errors=N               stop after N errors
+		//   -fdiagnostics-category-limit=N
+		//                                print at most N reports of one type
+		//   -fdiagnostics-format=text|json|sarif
+		// <name> is the type name in lower case with '-' instead of '_',
+		// e.g. '-Wno-unused-var'.
 		static void Init(std::vector<std::string> const& args);
+
+		// Clears counters, reports and include stack before the next
+		// compilation. No other thread may report at that time.
+		static void Reset();
+
+		// Formats all reports made so far and writes them to the output at
+		// once. No other thread may report at that time.
+		static void Flush();
+
+		static void SetOutput(std::ostream* output);
+
+		// Set by '-fdiagnostics-format=text|json|sarif' in Init()
+		static DiagnosticsFormat GetFormat();
 	
 		static void SetCurrentFile(ReportFile const& file);
 
@@ -62,40 +216,47 @@ namespace Pascal
 
 		static void ReportNote(size_t where, std::string const& msg);
 
+		// Listener is called from the reporting thread
+		static void SetListener(ReportListener* listener);
+
 		static unsigned GetErrorsCount();
 		static unsigned GetWarningsCount();
 		
 	private:
-		static std::vector<ReportFile> includeStack;
-
-		static ReportFile currentFile;
-		
-		static std::vector<ErrorType> disallowedErrors;
-		static std::vector<WarningType> disallowedWarnings;
-
-		static unsigned warningsCount;
-		static unsigned errorsCount;
+		static thread_local ReportsContext* context;
 
-		static bool treatWarningsAsError;
+		static ReportsContext& Current();
 
 		typedef struct
 		{
 			size_t where, startPos, endPos, column, lineNumber;
 		} ErrorPos;
 
-		static ErrorPos getErrorPos(size_t where);
+		// `lineStarts` holds position of the first character of every line
+		static ErrorPos getErrorPos(size_t where, std::vector<size_t> const& lineStarts);
 		
 		static std::string typeToString(ErrorType type);
 		static std::string typeToString(WarningType type);
 
-		enum class ReportType
-		{
-			WARNING,
-			ERROR,
-			NOTE
-		};
+		static void formatText(std::string& out, ReportBuffer::Record const& record,
+							   std::vector<size_t> const& lineStarts);
+		static void formatJson(std::string& out, ReportBuffer::Record const& record,
+							   std::vector<size_t> const& lineStarts);
+		static void formatSarif(std::string& out, ReportBuffer::Record const* group, size_t size,
+								std::vector<size_t> const& lineStarts);
+
+		// Records the report unless it is a duplicate or over the limit of
+		// its category. `categoryCount` may be null for reports without type.
+		// Returns false for duplicates, they aren't counted.
+		static bool AddReport(size_t where, ReportType type, std::string const& msg,
+							  std::atomic<unsigned>* categoryCount);
 
-		static void PrintReport(size_t where, ReportType type, std::string const& msg);
+		static void AddError(size_t where, std::string const& msg,
+							 std::atomic<unsigned>* categoryCount, bool noStop);
+		// Counts an error of a hidden type without recording it
+		static void HideError(bool noStop);
+		static void AddWarning(size_t where, std::string const& msg,
+							   std::atomic<unsigned>* categoryCount, bool noStop);
 	};
 	
 	class StopExecution : std::exception
@@ -2,19 +2,23 @@
 #define PASCAL_SEMANTIC_ANALYZER
 
 #include <Visitor.hpp>
-#include <Environment.hpp>
-#include <CodeGenVisitor.hpp>
-
-#include <memory>
+#include <TreeWalker.hpp>
 
 namespace Pascal
 {
+	// Checks what name resolution can't: assignments to constants and
+	// procedures, procedures used as values, calls of variables and the
+	// number of arguments.
+	//
+	// Runs on TreeWalker, visit methods don't recurse.
 	class SemanticAnalyzer : public AST::Visitor
 	{
 	public:
 		SemanticAnalyzer();
 		~SemanticAnalyzer();
 
+		void run(const AST::Node& root);
+
         void visitProgramNode(const AST::ProgramNode& node);
         void visitCompoundNode(const AST::CompoundNode& node);
         void visitVarDeclNode(const AST::VarDeclNode& node);
@@ -30,12 +34,11 @@ namespace Pascal
         void visitIfNode(const AST::IfNode& node);
         void visitFunctionCall(const AST::FunctionCallNode& node);
 
-    private:
-        std::shared_ptr<Environment<SymAttribs>> currentScope;
-        std::shared_ptr<Environment<SymAttribs>> globalScope;
+	private:
+		TreeWalker walker;
 
-        SymType lastType;
-        SymAttribs lastSym;
+		// Target of the assignment being checked, not read as a value
+		const AST::VarNode* assigned;
 	};
 }
 
@@ -0,0 +1,55 @@
+#ifndef PASCAL_SYMBOL_HPP
+#define PASCAL_SYMBOL_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace Pascal
+{
+	enum class SymType
+	{
+		INTEGER,
+		LONG,
+		PROCEDURE
+	};
+
+	struct Signature;
+
+	enum class StorageClass
+	{
+		// Name wasn't resolved
+		NONE,
+		BUILTIN,
+		GLOBAL,
+		PARAM,
+		LOCAL
+	};
+
+	// Result of name resolution, stored in the referencing AST node.
+	// `depth` is 0 for the program scope and 1 for procedures. `slot` is the
+	// position of the declaration among the declarations of its scope
+	// (parameters first), builtins are numbered separately. Procedures and
+	// functions refer to their signature in the TypeTable of the compilation.
+	// Constants whose value is known at compile time carry it, wrapped to
+	// their type; they take no storage.
+	struct SymbolRef
+	{
+		unsigned depth = 0;
+		unsigned slot = 0;
+		SymType type = SymType::INTEGER;
+		StorageClass storage = StorageClass::NONE;
+		bool isConst = false;
+		bool hasValue = false;
+		uint16_t value = 0;
+		const Signature* signature = nullptr;
+
+		bool isResolved() const { return storage != StorageClass::NONE; }
+	};
+
+	// Type named by a type identifier. Unknown names are INTEGER, they are
+	// reported by name resolution.
+	SymType GetSymType(std::string const& typeName);
+	bool IsTypeName(std::string const& name);
+} // namespace Pascal
+
+#endif // PASCAL_SYMBOL_HPP
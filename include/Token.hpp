@@ -14,7 +14,7 @@ namespace Pascal
 		// Single-character tokens
 		OPEN_PAREN, CLOSE_PAREN,
 		OPEN_BRACE, CLOSE_BRACE,
-		COMMA, DOT, SEMICOLON, COLON,
+		COMMA, DOT, SEMICOLON, COLON, EQUAL,
 		PLUS, MINUS, SLASH, STAR,
 
 		COLON_EQUAL,
@@ -0,0 +1,76 @@
+#ifndef PASCAL_TREEWALKER_HPP
+#define PASCAL_TREEWALKER_HPP
+
+#include <ASTForwards.hpp>
+#include <Visitor.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace Pascal
+{
+	// Walks the AST without recursion. Traversal state is kept in an explicit
+	// stack on the heap, so native stack usage doesn't depend on the tree depth.
+	//
+	// `pre` is called before the children of a node are visited, `post` after
+	// all of them. Both are plain visitors that must not recurse by themselves.
+	// Any of them can be nullptr.
+	class TreeWalker
+	{
+	public:
+		TreeWalker(AST::Visitor* pre, AST::Visitor* post = nullptr);
+
+		void walk(const AST::Node& root);
+
+		// Can be called from the pre-order callback: the children of the current
+		// node won't be visited (the post-order callback is still called).
+		void skipChildren();
+
+		// Can be called from the pre-order callback: the children of the current
+		// node are visited last to first.
+		void reverseChildren();
+
+	private:
+		struct Frame
+		{
+			const AST::Node* node;
+			bool entered;
+		};
+
+		AST::Visitor* pre;
+		AST::Visitor* post;
+
+		std::vector<Frame> stack;
+		std::vector<const AST::Node*> children;
+
+		bool skip;
+		bool reverse;
+	};
+
+	// Callback doing nothing on every node, callbacks of TreeWalker override
+	// the nodes they handle
+	class EmptyVisitor : public AST::Visitor
+	{
+	public:
+		void visitProgramNode(const AST::ProgramNode&) {}
+		void visitCompoundNode(const AST::CompoundNode&) {}
+		void visitVarDeclNode(const AST::VarDeclNode&) {}
+		void visitTypeNode(const AST::TypeNode&) {}
+		void visitProcDeclNode(const AST::ProcDeclNode&) {}
+		void visitAssignmentNode(const AST::AssignmentNode&) {}
+		void visitVarNode(const AST::VarNode&) {}
+		void visitIntLiteralNode(const AST::IntLiteralNode&) {}
+		void visitBinaryExprNode(const AST::BinaryExprNode&) {}
+		void visitUnaryExprNode(const AST::UnaryExprNode&) {}
+		void visitProcCallNode(const AST::CallStmtNode&) {}
+		void visitFunctionDeclNode(const AST::FunctionDeclNode&) {}
+		void visitIfNode(const AST::IfNode&) {}
+		void visitFunctionCall(const AST::FunctionCallNode&) {}
+	};
+
+	// Destroys the tree iteratively. Default destruction of unique_ptr
+	// chains is recursive and overflows on deeply nested programs.
+	void releaseTree(std::unique_ptr<AST::Node> root);
+} // namespace Pascal
+
+#endif // PASCAL_TREEWALKER_HPP
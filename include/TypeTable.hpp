@@ -0,0 +1,57 @@
+#ifndef PASCAL_TYPE_TABLE_HPP
+#define PASCAL_TYPE_TABLE_HPP
+
+#include <Symbol.hpp>
+
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+namespace Pascal
+{
+	// Parameter types and result of a procedure or function. `result` is
+	// PROCEDURE for procedures, which return nothing.
+	struct Signature
+	{
+		std::vector<SymType> params;
+		SymType result;
+
+		unsigned arity() const { return static_cast<unsigned>(params.size()); }
+	};
+
+	// Owns the signatures of one compilation. Signatures are interned by
+	// structure: equal signatures are the same record, so comparing them is
+	// comparing pointers. Records are never moved or freed before the table.
+	class TypeTable
+	{
+	public:
+		TypeTable() = default;
+		TypeTable(TypeTable const&) = delete;
+		TypeTable& operator=(TypeTable const&) = delete;
+
+		const Signature* intern(std::vector<SymType> params, SymType result);
+
+		// Number of distinct signatures
+		size_t size() const { return m_Signatures.size(); }
+
+	private:
+		struct Hash
+		{
+			size_t operator()(const Signature* signature) const;
+		};
+
+		struct Equal
+		{
+			bool operator()(const Signature* a, const Signature* b) const
+			{
+				return a->result == b->result && a->params == b->params;
+			}
+		};
+
+		// Arena: deque doesn't move records on push_back
+		std::deque<Signature> m_Signatures;
+		std::unordered_set<const Signature*, Hash, Equal> m_Index;
+	};
+} // namespace Pascal
+
+#endif // PASCAL_TYPE_TABLE_HPP
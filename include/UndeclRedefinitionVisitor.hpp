@@ -3,16 +3,30 @@
 
 #include <Visitor.hpp>
 #include <Environment.hpp>
+#include <TreeWalker.hpp>
+#include <Symbol.hpp>
+#include <TypeTable.hpp>
+#include <Token.hpp>
 
 #include <memory>
 
 namespace Pascal
 {
+    // Name resolution. Reports undeclared and redefined names and stores the
+    // resolved symbol in every declaration and reference, so later passes
+    // don't look names up.
+    //
+    // Runs on TreeWalker: visit methods don't recurse, scopes of procedures
+    // and functions are closed in the post-order callback. Variables are
+    // declared there too, after the value of a constant.
     class UndeclRedefinitionVisitor : public AST::Visitor
     {
     public:
-        UndeclRedefinitionVisitor();
+        // Signatures of procedures and functions are interned in `types`
+        UndeclRedefinitionVisitor(TypeTable& types);
         ~UndeclRedefinitionVisitor();
+
+        void run(const AST::Node& root);
         
         void visitProgramNode(const AST::ProgramNode& node);
         void visitCompoundNode(const AST::CompoundNode& node);
@@ -30,10 +44,43 @@ namespace Pascal
         void visitFunctionCall(const AST::FunctionCallNode& node);
 
     private:
-        std::shared_ptr<Environment<int>> currentScope;
-        std::shared_ptr<Environment<int>> globalScope;
+        struct Declared
+        {
+            size_t pos;
+            SymbolRef symbol;
+        };
+
+        Environment<Declared> scopes;
+        TypeTable& types;
+
+        // Declarations made in every open scope
+        std::vector<unsigned> slotsCount;
+
+        // Parameters of the current procedure not visited yet
+        size_t paramsLeft;
+
+        // Fills depth and slot. Returns false on redefinition
+        bool declare(Token const& name, SymbolRef& symbol);
+        void resolve(Token const& name, SymbolRef& symbol);
+
+        template <typename Decl>
+        const Signature* signatureOf(Decl const& node, SymType result);
+
+        class ScopeExit : public EmptyVisitor
+        {
+        public:
+            ScopeExit(UndeclRedefinitionVisitor* owner);
+
+            void visitVarDeclNode(const AST::VarDeclNode& node);
+            void visitProcDeclNode(const AST::ProcDeclNode& node);
+            void visitFunctionDeclNode(const AST::FunctionDeclNode& node);
+
+        private:
+            UndeclRedefinitionVisitor* owner;
+        };
 
-        void check(const std::unique_ptr<AST::Node>& node);
+        ScopeExit scopeExit;
+        TreeWalker walker;
     }; // class UndeclRedefinition
 } // namespace Pascal
 
@@ -2,16 +2,30 @@
 #define PASCAL_USEDINITIALIZED_HPP
 
 #include <Visitor.hpp>
-#include <Environment.hpp>
+#include <AnalysisCache.hpp>
+#include <Symbol.hpp>
+#include <Token.hpp>
+#include <TreeWalker.hpp>
+
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace Pascal
 {
+    // Warns about variables read before any assignment and names never used.
+    //
+    // Runs on TreeWalker: visit methods don't recurse. Variables are declared
+    // and assignments take effect in the post-order callback, after the
+    // expressions they read.
     class UsedInitializedVisitor : public AST::Visitor
     {
     public:
-        UsedInitializedVisitor();
+        UsedInitializedVisitor(const AnalysisCache* cache = nullptr);
         ~UsedInitializedVisitor();
+
+        void run(const AST::Node& root);
         
         void visitProgramNode(const AST::ProgramNode& node);
         void visitCompoundNode(const AST::CompoundNode& node);
@@ -37,10 +51,46 @@ namespace Pascal
             size_t pos;
         };
 
-        std::shared_ptr<Environment<Attribs>> currentScope;
-        std::shared_ptr<Environment<Attribs>> globalScope;
+        // Indexed by the slot of the symbol
+        std::vector<Attribs> globals;
+        std::vector<Attribs> locals;
+
+        // Only for applying cached summaries, which refer to globals by name
+        std::unordered_map<std::string, unsigned> globalSlots;
+
+        const AnalysisCache* cache;
+
+        // Target of the assignment being visited, not read as a value
+        const AST::VarNode* assigned;
 
         void check(const std::unique_ptr<AST::Node>& node);
+
+        void declare(Token const& name, SymbolRef const& symbol, Attribs attrs);
+
+        // Null for builtins
+        Attribs* lookup(SymbolRef const& symbol);
+
+        // Reports unused names of the scope, once per procedure and once for
+        // the program, nested compound statements don't open scopes
+        void exitScope(std::vector<Attribs> const& scope);
+
+        class ScopeExit : public EmptyVisitor
+        {
+        public:
+            ScopeExit(UsedInitializedVisitor* owner);
+
+            void visitProgramNode(const AST::ProgramNode& node);
+            void visitVarDeclNode(const AST::VarDeclNode& node);
+            void visitProcDeclNode(const AST::ProcDeclNode& node);
+            void visitAssignmentNode(const AST::AssignmentNode& node);
+            void visitFunctionDeclNode(const AST::FunctionDeclNode& node);
+
+        private:
+            UsedInitializedVisitor* owner;
+        };
+
+        ScopeExit scopeExit;
+        TreeWalker walker;
     }; // class UsedInitialized
 } // namespace Pascal
 
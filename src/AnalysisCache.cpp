@@ -0,0 +1,435 @@
+#include <AnalysisCache.hpp>
+#include <AST.hpp>
+#include <TreeWalker.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <set>
+
+namespace Pascal
+{
+	const char* const AnalysisCache::FormatVersion = "4";
+
+	namespace
+	{
+		// FNV-1a
+		const uint64_t HashBasis = 14695981039346656037ULL;
+		const uint64_t HashPrime = 1099511628211ULL;
+
+		uint64_t mix(uint64_t hash, std::string const& str)
+		{
+			for (unsigned char ch : str)
+			{
+				hash ^= ch;
+				hash *= HashPrime;
+			}
+
+			// Separator, so "ab" "c" and "a" "bc" differ
+			hash ^= 0xFF;
+			hash *= HashPrime;
+			return hash;
+		}
+
+		uint64_t mix(uint64_t hash, uint64_t value)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				hash ^= (value >> (i * 8)) & 0xFF;
+				hash *= HashPrime;
+			}
+			return hash;
+		}
+
+		typedef std::unordered_map<std::string, uint64_t> Signatures;
+
+		// Hashes tokens of a procedure and collects names it refers to.
+		// Inside a procedure the offset of every token from its name is
+		// hashed too: cached reports are replayed at such offsets, so a
+		// whitespace change must make a new key. Runs as a pre-order
+		// callback of TreeWalker.
+		class ProcedureHasher : public AST::Visitor
+		{
+		public:
+			ProcedureHasher()
+				: hash(mix(HashBasis, std::string(AnalysisCache::FormatVersion))),
+				  start(0), end(0), inProcedure(false)
+			{ }
+
+			uint64_t hash;
+			size_t start, end;
+
+			std::set<std::string> locals;
+			std::set<std::string> referenced;
+			std::set<std::string> assigned;
+
+			void visitProgramNode(const AST::ProgramNode&)
+			{ }
+
+			void visitCompoundNode(const AST::CompoundNode& node)
+			{
+				hash = mix(hash, std::string("C"));
+				hash = mix(hash, static_cast<uint64_t>(node.stmts.size()));
+			}
+
+			void visitVarDeclNode(const AST::VarDeclNode& node)
+			{
+				token(node.isConst ? "K" : "V", node.name);
+				locals.insert(node.name.str);
+			}
+
+			void visitTypeNode(const AST::TypeNode& node)
+			{
+				token("T", node.token);
+			}
+
+			void visitProcDeclNode(const AST::ProcDeclNode& node)
+			{
+				start = node.name.pos;
+				inProcedure = true;
+
+				token("P", node.name);
+				hash = mix(hash, static_cast<uint64_t>(node.params.size()));
+			}
+
+			void visitAssignmentNode(const AST::AssignmentNode& node)
+			{
+				hash = mix(hash, std::string("A"));
+				assigned.insert(node.var->token.str);
+			}
+
+			void visitVarNode(const AST::VarNode& node)
+			{
+				token("v", node.token);
+				referenced.insert(node.token.str);
+			}
+
+			void visitIntLiteralNode(const AST::IntLiteralNode& node)
+			{
+				token("i", node.token);
+			}
+
+			void visitBinaryExprNode(const AST::BinaryExprNode& node)
+			{
+				token("B", node.op);
+			}
+
+			void visitUnaryExprNode(const AST::UnaryExprNode& node)
+			{
+				token("U", node.op);
+			}
+
+			void visitProcCallNode(const AST::CallStmtNode& node)
+			{
+				token("c", node.name);
+				hash = mix(hash, static_cast<uint64_t>(node.args.size()));
+				referenced.insert(node.name.str);
+			}
+
+			void visitFunctionDeclNode(const AST::FunctionDeclNode& node)
+			{
+				token("F", node.name);
+			}
+
+			void visitIfNode(const AST::IfNode& node)
+			{
+				hash = mix(hash, std::string(node.elseArm != nullptr ? "IE" : "I"));
+			}
+
+			void visitFunctionCall(const AST::FunctionCallNode& node)
+			{
+				token("f", node.name);
+				hash = mix(hash, static_cast<uint64_t>(node.args.size()));
+				referenced.insert(node.name.str);
+			}
+
+		private:
+			// Constant values are hashed outside of procedures, where they
+			// are folded into the code and their positions don't matter
+			bool inProcedure;
+
+			void token(const char* tag, Token const& tok)
+			{
+				hash = mix(hash, std::string(tag));
+				hash = mix(hash, tok.str);
+				if (inProcedure) hash = mix(hash, static_cast<uint64_t>(tok.pos - start));
+				if (tok.pos > end) end = tok.pos;
+			}
+		};
+
+		uint64_t varSignature(const AST::VarDeclNode& node, Signatures const& globals)
+		{
+			uint64_t res = mix(HashBasis, std::string(node.isConst ? "const" : "var"));
+			res = mix(res, node.type->token.str);
+
+			// Values of constants are folded into the code using them
+			if (node.value != nullptr)
+			{
+				ProcedureHasher hasher;
+				TreeWalker walker(&hasher);
+				walker.walk(*node.value);
+
+				res = mix(res, hasher.hash);
+				for (auto const& name : hasher.referenced)
+				{
+					auto it = globals.find(name);
+					res = mix(res, it != globals.end() ? it->second : 0);
+				}
+			}
+
+			return res;
+		}
+
+		uint64_t procSignature(const AST::ProcDeclNode& node)
+		{
+			uint64_t res = mix(HashBasis, std::string("procedure"));
+			for (auto const& param : node.params)
+				res = mix(res, param->type->token.str);
+			return res;
+		}
+
+		std::string hexKey(uint64_t key)
+		{
+			char buf[17];
+			std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(key));
+			return buf;
+		}
+
+		const char* const Magic = "pascalc-analysis-cache";
+	}
+
+	AnalysisCache::AnalysisCache(std::string const& directory, std::vector<std::string> const& args)
+		: directory(directory), flagsHash(HashBasis),
+		  hits(0), misses(0), stores(0), invalid(0)
+	{
+		if (!this->directory.empty() && this->directory.back() != '/' && this->directory.back() != '\\')
+			this->directory += '/';
+
+		// Only options change the results, file names don't
+		for (auto it = args.begin(); it != args.end(); ++it)
+		{
+			if (*it == "-o")
+			{
+				if (++it == args.end()) break;
+			}
+			else if (it->rfind("-", 0) == 0 && it->rfind("-fcache", 0) != 0)
+			{
+				flagsHash = mix(flagsHash, *it);
+			}
+		}
+	}
+
+	void AnalysisCache::prepare(AST::ProgramNode& tree)
+	{
+		// Global names declared so far, as a procedure at this point sees them.
+		// A variable's signature also changes with every procedure that assigns
+		// it, because the initialization state is a part of the analysis.
+		Signatures globals;
+
+		for (auto const& decl : tree.decls)
+		{
+			if (auto var = dynamic_cast<const AST::VarDeclNode*>(decl.get()))
+			{
+				globals[var->name.str] = varSignature(*var, globals);
+				continue;
+			}
+
+			auto proc = dynamic_cast<AST::ProcDeclNode*>(decl.get());
+			if (proc == nullptr) continue;
+
+			globals[proc->name.str] = procSignature(*proc);
+
+			ProcedureHasher hasher;
+			TreeWalker walker(&hasher);
+			walker.walk(*proc);
+
+			Entry entry;
+			entry.key = mix(hasher.hash, flagsHash);
+			entry.start = hasher.start;
+			entry.end = hasher.end;
+
+			for (auto const& name : hasher.referenced)
+			{
+				if (hasher.locals.count(name)) continue;
+
+				auto it = globals.find(name);
+				entry.key = mix(entry.key, name);
+				entry.key = mix(entry.key, it != globals.end() ? it->second : 0);
+
+				if (it != globals.end()) entry.summary.used.push_back(name);
+			}
+
+			for (auto const& name : hasher.assigned)
+			{
+				if (hasher.locals.count(name)) continue;
+
+				auto it = globals.find(name);
+				if (it == globals.end()) continue;
+
+				entry.summary.initialized.push_back(name);
+				it->second = mix(it->second, entry.key);
+			}
+
+			entry.hit = load(entry);
+			if (entry.hit)
+			{
+				hits++;
+				proc->isCached = true;
+
+				for (auto const& report : entry.reports)
+				{
+					size_t where = static_cast<size_t>(entry.start + report.offset);
+					switch (report.type)
+					{
+					case ReportType::ERROR:
+						ReportsManager::ReportError(where, report.msg);
+						break;
+					case ReportType::WARNING:
+						ReportsManager::ReportWarning(where, report.msg);
+						break;
+					case ReportType::NOTE:
+						ReportsManager::ReportNote(where, report.msg);
+						break;
+					}
+				}
+			}
+			else
+			{
+				misses++;
+			}
+
+			entries[proc] = std::move(entry);
+			order.push_back(proc);
+		}
+	}
+
+	void AnalysisCache::commit()
+	{
+		for (auto proc : order)
+		{
+			Entry& entry = entries[proc];
+			if (entry.hit) continue;
+
+			entry.reports.clear();
+			for (auto const& report : recorded)
+			{
+				if (report.where < entry.start || report.where > entry.end) continue;
+
+				entry.reports.push_back({ report.type,
+					static_cast<int64_t>(report.where) - static_cast<int64_t>(entry.start), report.msg });
+			}
+
+			if (store(entry)) stores++;
+		}
+	}
+
+	void AnalysisCache::onReport(size_t where, ReportType type, std::string const& msg)
+	{
+		recorded.push_back({ where, type, msg });
+	}
+
+	AnalysisCache::Summary const& AnalysisCache::getSummary(const AST::ProcDeclNode& node) const
+	{
+		return entries.at(&node).summary;
+	}
+
+	void AnalysisCache::printStats(std::ostream& out) const
+	{
+		out << "Analysis cache: " << hits << " hits, " << misses << " misses, "
+			<< stores << " stored, " << invalid << " invalid entries." << std::endl;
+	}
+
+	std::string AnalysisCache::entryPath(uint64_t key) const
+	{
+		return directory + hexKey(key) + ".pcache";
+	}
+
+	bool AnalysisCache::load(Entry& entry)
+	{
+		std::ifstream fin(entryPath(entry.key), std::ios::in | std::ios::binary);
+		if (!fin.is_open()) return false;
+
+		std::string magic, version, key, word;
+		size_t count = 0;
+
+		fin >> magic >> version >> key >> word >> count;
+		if (!fin || magic != Magic || version != FormatVersion
+			|| key != hexKey(entry.key) || word != "reports")
+		{
+			invalid++;
+			return false;
+		}
+
+		std::vector<CachedReport> reports;
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned type = 0;
+			int64_t offset = 0;
+			size_t length = 0;
+
+			fin >> type >> offset >> length;
+			fin.get();
+
+			std::string msg(length, '\0');
+			if (length != 0) fin.read(&msg[0], length);
+
+			if (!fin || type > static_cast<unsigned>(ReportType::NOTE))
+			{
+				invalid++;
+				return false;
+			}
+
+			reports.push_back({ static_cast<ReportType>(type), offset, msg });
+		}
+
+		fin >> magic;
+		if (!fin || magic != "end")
+		{
+			invalid++;
+			return false;
+		}
+
+		entry.reports = std::move(reports);
+		return true;
+	}
+
+	bool AnalysisCache::store(Entry const& entry)
+	{
+		// Write to a uniquely named temporary file first, so a concurrent or
+		// interrupted compilation never sees a half-written entry
+		std::string path = entryPath(entry.key);
+		std::string tempPath = path + ".tmp" + std::to_string(std::random_device()());
+
+		{
+			std::ofstream fout(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!fout.is_open()) return false;
+
+			fout << Magic << ' ' << FormatVersion << '\n'
+				 << hexKey(entry.key) << '\n'
+				 << "reports " << entry.reports.size() << '\n';
+
+			for (auto const& report : entry.reports)
+			{
+				fout << static_cast<unsigned>(report.type) << ' ' << report.offset << ' '
+					 << report.msg.size() << '\n' << report.msg << '\n';
+			}
+
+			fout << "end" << '\n';
+
+			if (!fout) return false;
+		}
+
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+		{
+			// rename() doesn't replace existing files everywhere
+			std::remove(path.c_str());
+			if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+			{
+				std::remove(tempPath.c_str());
+				return false;
+			}
+		}
+
+		return true;
+	}
+} // namespace Pascal
@@ -0,0 +1,163 @@
+#include <BatchCompiler.hpp>
+#include <Driver.hpp>
+#include <ReportsManager.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace Pascal
+{
+	namespace
+	{
+		std::string outputNameFor(std::string const& inFileName, std::string const& extension)
+		{
+			size_t dot = inFileName.find_last_of('.');
+			size_t slash = inFileName.find_last_of("/\\");
+
+			if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+				return inFileName + extension;
+
+			return inFileName.substr(0, dot) + extension;
+		}
+	}
+
+	BatchCompiler::BatchCompiler(std::vector<std::string> const& args)
+		: threadsCount(GetThreadsCount(args)), nextJob(0)
+	{
+		// '-j' doesn't change the results, so drivers (and the analysis
+		// cache keys) don't see it
+		for (auto it = args.begin(); it != args.end(); ++it)
+		{
+			if (*it == "-j")
+			{
+				if (++it == args.end()) break;
+			}
+			else if (it->rfind("-j", 0) != 0)
+			{
+				this->args.push_back(*it);
+			}
+		}
+
+		std::vector<std::string> inputs = Driver::GetInputFileNames(args);
+		for (auto const& input : inputs)
+		{
+			jobs.push_back({ input, inputs.size() == 1 ? Driver::GetOutputFileName(args) : outputNameFor(input, Driver::GetOutputExtension(args)), "", 0 });
+		}
+
+		threadsCount = std::max(1u, std::min<unsigned>(threadsCount, static_cast<unsigned>(jobs.size())));
+	}
+
+	int BatchCompiler::run()
+	{
+		if (jobs.size() > 1 && std::find(args.begin(), args.end(), "-o") != args.end())
+		{
+			std::cout << TermColor::BrightRed << "error" << TermColor::BrightWhite <<
+				": '-o' can't be used with multiple input files" << TermColor::Reset << std::endl;
+			return 2;
+		}
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < threadsCount; i++)
+			threads.emplace_back(&BatchCompiler::worker, this);
+
+		worker();
+
+		for (auto& thread : threads)
+			thread.join();
+
+		int status = 0;
+		for (auto const& job : jobs)
+		{
+			std::cout << job.diagnostics;
+			status = std::max(status, job.status);
+		}
+		std::cout << std::flush;
+
+		return status;
+	}
+
+	void BatchCompiler::worker()
+	{
+		for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+		{
+			compile(jobs[i]);
+		}
+	}
+
+	void BatchCompiler::compile(Job& job)
+	{
+		std::stringstream diagnostics;
+
+		std::ifstream fin(job.inFileName);
+		if (!fin.is_open())
+		{
+			diagnostics << TermColor::BrightRed << "error" << TermColor::BrightWhite <<
+				": can't open file \"" << job.inFileName << "\"" << TermColor::Reset << std::endl;
+			job.diagnostics = diagnostics.str();
+			job.status = 2;
+			return;
+		}
+
+		std::shared_ptr<std::string> source = std::make_shared<std::string>();
+
+		{
+			std::stringstream ss;
+			ss << fin.rdbuf();
+			*source = ss.str();
+		}
+
+		Driver driver(args);
+		job.status = driver.compile(job.inFileName, source, diagnostics);
+
+		if (!driver.getOutput().empty())
+		{
+			std::ofstream fout(job.outFileName, std::ios::out | std::ios::binary);
+			if (!fout.is_open())
+			{
+				diagnostics << "error: couldn't open file '" << job.outFileName << "'" << std::endl;
+				job.status = 2;
+			}
+			else
+			{
+				fout.write(driver.getOutput().data(), driver.getOutput().size());
+			}
+		}
+
+		job.diagnostics = diagnostics.str();
+	}
+
+	unsigned BatchCompiler::GetThreadsCount(std::vector<std::string> const& args)
+	{
+		unsigned count = 0;
+		for (auto it = args.begin(); it != args.end(); ++it)
+		{
+			if (*it == "-j")
+			{
+				if (++it == args.end()) break;
+				count = static_cast<unsigned>(std::strtoul(it->c_str(), nullptr, 10));
+			}
+			else if (it->rfind("-j", 0) == 0)
+			{
+				count = static_cast<unsigned>(std::strtoul(it->c_str() + 2, nullptr, 10));
+			}
+		}
+
+		if (count == 0) count = std::thread::hardware_concurrency();
+		return count == 0 ? 1 : count;
+	}
+
+	bool BatchCompiler::IsRequested(std::vector<std::string> const& args)
+	{
+		for (auto const& arg : args)
+		{
+			if (arg.rfind("-j", 0) == 0) return true;
+		}
+
+		return Driver::GetInputFileNames(args).size() > 1;
+	}
+} // namespace Pascal
@@ -0,0 +1,96 @@
+#include <CallGraph.hpp>
+
+#include <algorithm>
+
+namespace Pascal
+{
+	CallGraph::CallGraph(IR::Module const& module)
+	{
+		size_t count = module.functions.size();
+		m_Callees.resize(count);
+
+		for (size_t f = 0; f < count; f++)
+		{
+			auto& callees = m_Callees[f];
+			for (auto const& block : module.functions[f].blocks)
+				for (auto const& instr : block.instrs)
+					if (instr.op == IR::Opcode::CALL) callees.push_back(instr.target);
+
+			std::sort(callees.begin(), callees.end());
+			callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+		}
+
+		// A search from every function
+		m_Reaches.assign(count, std::vector<bool>(count, false));
+		for (size_t f = 0; f < count; f++)
+		{
+			std::vector<bool>& reached = m_Reaches[f];
+			std::vector<unsigned> worklist = m_Callees[f];
+
+			while (!worklist.empty())
+			{
+				unsigned next = worklist.back();
+				worklist.pop_back();
+
+				if (reached[next]) continue;
+				reached[next] = true;
+
+				for (unsigned callee : m_Callees[next])
+					if (!reached[callee]) worklist.push_back(callee);
+			}
+		}
+
+		// Functions are found to return until nothing changes
+		m_Returns.assign(count, false);
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			for (size_t f = 0; f < count; f++)
+			{
+				if (m_Returns[f] || !findsReturn(module.functions[f])) continue;
+
+				m_Returns[f] = true;
+				changed = true;
+			}
+		}
+	}
+
+	bool CallGraph::findsReturn(IR::Function const& function) const
+	{
+		if (function.blocks.empty())
+			return false;
+
+		std::vector<bool> visited(function.blocks.size(), false);
+		std::vector<unsigned> worklist = { 0 };
+
+		while (!worklist.empty())
+		{
+			unsigned b = worklist.back();
+			worklist.pop_back();
+
+			if (visited[b] || function.blocks[b].instrs.empty()) continue;
+			visited[b] = true;
+
+			bool passes = true;
+			for (auto const& instr : function.blocks[b].instrs)
+			{
+				if (instr.op == IR::Opcode::CALL && !m_Returns[instr.target])
+				{
+					passes = false;
+					break;
+				}
+			}
+			if (!passes) continue;
+
+			IR::Instr const& last = function.blocks[b].terminator();
+			if (last.op == IR::Opcode::RET)
+				return true;
+
+			worklist.push_back(last.target);
+			if (last.op == IR::Opcode::BRANCH)
+				worklist.push_back(last.elseTarget);
+		}
+
+		return false;
+	}
+} // namespace Pascal
@@ -0,0 +1,169 @@
+#include <Chip8Assembler.hpp>
+
+namespace Pascal
+{
+	namespace
+	{
+		const unsigned Undefined = static_cast<unsigned>(-1);
+
+		uint16_t xy(unsigned base, unsigned x, unsigned y)
+		{
+			return static_cast<uint16_t>(base | ((x & 0xF) << 8) | ((y & 0xF) << 4));
+		}
+
+		uint16_t xnn(unsigned base, unsigned x, unsigned nn)
+		{
+			return static_cast<uint16_t>(base | ((x & 0xF) << 8) | (nn & 0xFF));
+		}
+	}
+
+	bool Chip8Assembler::assemble(Chip8::Code const& code)
+	{
+		labels.assign(code.labelsCount(), Undefined);
+		rom.clear();
+		size = 0;
+		error.clear();
+
+		// Every instruction and data word takes two bytes, labels mark the
+		// next one
+		for (auto const& instr : code.instrs)
+		{
+			if (instr.op == Chip8::Op::LABEL)
+				labels[instr.label] = LoadAddress + size;
+			else if (!Chip8::IsPseudo(instr.op))
+				size += 2;
+		}
+
+		if (LoadAddress + size > MemorySize)
+		{
+			error = "program takes " + std::to_string(size) + " bytes, at most " +
+				std::to_string(MemorySize - LoadAddress) + " fit into the memory";
+			return false;
+		}
+
+		if (LoadAddress + size + code.reserved > MemorySize)
+		{
+			error = "program takes " + std::to_string(size) + " bytes and its frames " + std::to_string(code.reserved) +
+				" more, at most " + std::to_string(MemorySize - LoadAddress) + " fit into the memory";
+			return false;
+		}
+
+		rom.reserve(size);
+		for (auto const& instr : code.instrs)
+		{
+			if (Chip8::IsPseudo(instr.op))
+				continue;
+
+			uint16_t word = 0;
+			if (!encode(code, instr, word))
+				return false;
+
+			rom += static_cast<char>(word >> 8);
+			rom += static_cast<char>(word & 0xFF);
+		}
+
+		return true;
+	}
+
+	bool Chip8Assembler::encode(Chip8::Code const& code, Chip8::Instr const& instr, uint16_t& word)
+	{
+		using Chip8::Op;
+
+		unsigned x = instr.x;
+		unsigned y = instr.y;
+		unsigned imm = instr.imm;
+		uint16_t addr = 0;
+
+		switch (instr.op)
+		{
+		case Op::CLS: word = 0x00E0; return true;
+		case Op::RET: word = 0x00EE; return true;
+		// SYS 0 is `break`, the emulator stops there
+		case Op::SYS:
+			if (!address(code, instr, addr)) return false;
+			word = addr;
+			return true;
+		case Op::JP:
+			if (!address(code, instr, addr)) return false;
+			word = static_cast<uint16_t>(0x1000 | addr);
+			return true;
+		case Op::CALL:
+			if (!address(code, instr, addr)) return false;
+			word = static_cast<uint16_t>(0x2000 | addr);
+			return true;
+		case Op::SE_IMM: word = xnn(0x3000, x, imm); return true;
+		case Op::SNE_IMM: word = xnn(0x4000, x, imm); return true;
+		case Op::SE: word = xy(0x5000, x, y); return true;
+		case Op::LD_IMM: word = xnn(0x6000, x, imm); return true;
+		case Op::ADD_IMM: word = xnn(0x7000, x, imm); return true;
+		case Op::LD: word = xy(0x8000, x, y); return true;
+		case Op::OR: word = xy(0x8001, x, y); return true;
+		case Op::AND: word = xy(0x8002, x, y); return true;
+		case Op::XOR: word = xy(0x8003, x, y); return true;
+		case Op::ADD: word = xy(0x8004, x, y); return true;
+		case Op::SUB: word = xy(0x8005, x, y); return true;
+		case Op::SHR: word = xy(0x8006, x, x); return true;
+		case Op::SUBN: word = xy(0x8007, x, y); return true;
+		case Op::SHL: word = xy(0x800E, x, x); return true;
+		case Op::SNE: word = xy(0x9000, x, y); return true;
+		case Op::LD_I:
+			if (!address(code, instr, addr)) return false;
+			word = static_cast<uint16_t>(0xA000 | addr);
+			return true;
+		case Op::JP_V0:
+			if (!address(code, instr, addr)) return false;
+			word = static_cast<uint16_t>(0xB000 | addr);
+			return true;
+		case Op::RND: word = xnn(0xC000, x, imm); return true;
+		case Op::DRW: word = static_cast<uint16_t>(xy(0xD000, x, y) | (imm & 0xF)); return true;
+		case Op::SKP: word = xnn(0xE000, x, 0x9E); return true;
+		case Op::SKNP: word = xnn(0xE000, x, 0xA1); return true;
+		case Op::LD_DT_TO: word = xnn(0xF000, x, 0x07); return true;
+		case Op::LD_KEY: word = xnn(0xF000, x, 0x0A); return true;
+		case Op::LD_DT: word = xnn(0xF000, x, 0x15); return true;
+		case Op::LD_ST: word = xnn(0xF000, x, 0x18); return true;
+		case Op::ADD_I: word = xnn(0xF000, x, 0x1E); return true;
+		case Op::LD_F: word = xnn(0xF000, x, 0x29); return true;
+		case Op::LD_B: word = xnn(0xF000, x, 0x33); return true;
+		case Op::STORE: word = xnn(0xF000, x, 0x55); return true;
+		case Op::LOAD: word = xnn(0xF000, x, 0x65); return true;
+		case Op::DATA: word = static_cast<uint16_t>(imm); return true;
+		case Op::LABEL:
+		case Op::COMMENT:
+			break;
+		}
+
+		return fail("can't encode a pseudo instruction");
+	}
+
+	bool Chip8Assembler::address(Chip8::Code const& code, Chip8::Instr const& instr, uint16_t& value)
+	{
+		if (instr.label == Chip8::NoLabel)
+		{
+			value = static_cast<uint16_t>(instr.imm & 0xFFF);
+			return true;
+		}
+
+		std::string const& name = code.labelName(instr.label);
+
+		unsigned addr = labels[instr.label];
+		if (addr == Undefined)
+			return fail("undefined label [" + name + "]");
+
+		// Labels after the last instruction, like the stack zone, may end
+		// up out of the memory, and so may addresses past them
+		addr += instr.imm;
+		if (addr >= MemorySize)
+			return fail("address [" + name + " + " + std::to_string(instr.imm) + "] is out of the memory");
+
+		value = static_cast<uint16_t>(addr);
+		return true;
+	}
+
+	bool Chip8Assembler::fail(std::string const& msg)
+	{
+		if (error.empty())
+			error = msg;
+		return false;
+	}
+} // namespace Pascal
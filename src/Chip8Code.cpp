@@ -0,0 +1,209 @@
+#include <Chip8Code.hpp>
+
+namespace Pascal
+{
+	namespace Chip8
+	{
+		namespace
+		{
+			void appendReg(std::string& out, unsigned reg)
+			{
+				out += 'v';
+				out += "0123456789ABCDEF"[reg & 0xF];
+			}
+
+			// `op vX, vY`
+			void appendRegs(std::string& out, const char* op, Instr const& instr)
+			{
+				out += op;
+				out += ' ';
+				appendReg(out, instr.x);
+				out += ", ";
+				appendReg(out, instr.y);
+			}
+
+			// `op address`, the operand of jumps, calls and ld I
+			void appendAddress(std::string& out, const char* op, Instr const& instr, std::vector<std::string> const& labels)
+			{
+				out += op;
+				if (instr.label == NoLabel)
+				{
+					out += std::to_string(instr.imm);
+					return;
+				}
+
+				out += '[';
+				out += labels[instr.label];
+				if (instr.imm != 0)
+				{
+					out += " + ";
+					out += std::to_string(instr.imm);
+				}
+				out += ']';
+			}
+
+			// `op vX, nn`
+			void appendImm(std::string& out, const char* op, Instr const& instr)
+			{
+				out += op;
+				out += ' ';
+				appendReg(out, instr.x);
+				out += ", ";
+				out += std::to_string(instr.imm);
+			}
+
+			// `op vX`, `op vX, suffix` or `op prefix, vX`
+			void appendOne(std::string& out, const char* op, Instr const& instr,
+						   const char* prefix = nullptr, const char* suffix = nullptr)
+			{
+				out += op;
+				out += ' ';
+				if (prefix != nullptr)
+				{
+					out += prefix;
+					out += ", ";
+				}
+				appendReg(out, instr.x);
+				if (suffix != nullptr)
+				{
+					out += ", ";
+					out += suffix;
+				}
+			}
+		}
+
+		bool IsPseudo(Op op)
+		{
+			return op == Op::LABEL || op == Op::COMMENT;
+		}
+
+		bool IsSkip(Op op)
+		{
+			return op == Op::SE_IMM || op == Op::SNE_IMM || op == Op::SE || op == Op::SNE ||
+				op == Op::SKP || op == Op::SKNP;
+		}
+
+		void Code::add(Op op, unsigned x, unsigned y, unsigned imm)
+		{
+			Instr instr;
+			instr.op = op;
+			instr.x = static_cast<uint8_t>(x);
+			instr.y = static_cast<uint8_t>(y);
+			instr.imm = static_cast<uint16_t>(imm);
+			instrs.push_back(instr);
+		}
+
+		void Code::addAddress(Op op, std::string const& name, unsigned offset)
+		{
+			Instr instr;
+			instr.op = op;
+			instr.imm = static_cast<uint16_t>(offset);
+			instr.label = label(name);
+			instrs.push_back(instr);
+		}
+
+		void Code::defineLabel(std::string const& name)
+		{
+			addAddress(Op::LABEL, name);
+		}
+
+		void Code::addComment(std::string const& text)
+		{
+			Instr instr;
+			instr.op = Op::COMMENT;
+			instr.label = static_cast<unsigned>(comments.size());
+			comments.push_back(text);
+			instrs.push_back(instr);
+		}
+
+		unsigned Code::label(std::string const& name)
+		{
+			auto it = labelNumbers.find(name);
+			if (it != labelNumbers.end()) return it->second;
+
+			labels.push_back(name);
+			labelNumbers.emplace(name, labelsCount() - 1);
+			return labelsCount() - 1;
+		}
+
+		unsigned Code::findLabel(std::string const& name) const
+		{
+			auto it = labelNumbers.find(name);
+			return it != labelNumbers.end() ? it->second : NoLabel;
+		}
+
+		std::string Code::toAssembly() const
+		{
+			std::string out;
+			out.reserve(instrs.size() * 12);
+
+			for (auto const& instr : instrs)
+			{
+				switch (instr.op)
+				{
+				case Op::CLS: out += "cls"; break;
+				case Op::RET: out += "ret"; break;
+				case Op::SYS:
+					if (instr.imm == 0) out += "break";
+					else appendAddress(out, "sys ", instr, labels);
+					break;
+				case Op::JP: appendAddress(out, "jp ", instr, labels); break;
+				case Op::CALL: appendAddress(out, "call ", instr, labels); break;
+				case Op::SE_IMM: appendImm(out, "se", instr); break;
+				case Op::SNE_IMM: appendImm(out, "sne", instr); break;
+				case Op::SE: appendRegs(out, "se", instr); break;
+				case Op::LD_IMM: appendImm(out, "ld", instr); break;
+				case Op::ADD_IMM: appendImm(out, "add", instr); break;
+				case Op::LD: appendRegs(out, "ld", instr); break;
+				case Op::OR: appendRegs(out, "or", instr); break;
+				case Op::AND: appendRegs(out, "and", instr); break;
+				case Op::XOR: appendRegs(out, "xor", instr); break;
+				case Op::ADD: appendRegs(out, "add", instr); break;
+				case Op::SUB: appendRegs(out, "sub", instr); break;
+				case Op::SHR: appendOne(out, "shr", instr); break;
+				case Op::SUBN: appendRegs(out, "subn", instr); break;
+				case Op::SHL: appendOne(out, "shl", instr); break;
+				case Op::SNE: appendRegs(out, "sne", instr); break;
+				case Op::LD_I: appendAddress(out, "ld I, ", instr, labels); break;
+				case Op::JP_V0: appendAddress(out, "jp v0, ", instr, labels); break;
+				case Op::RND: appendImm(out, "rnd", instr); break;
+				case Op::DRW:
+					appendRegs(out, "drw", instr);
+					out += ", ";
+					out += std::to_string(instr.imm);
+					break;
+				case Op::SKP: appendOne(out, "skp", instr); break;
+				case Op::SKNP: appendOne(out, "sknp", instr); break;
+				case Op::LD_DT_TO: appendOne(out, "ld", instr, nullptr, "DT"); break;
+				case Op::LD_KEY: appendOne(out, "ld", instr, nullptr, "K"); break;
+				case Op::LD_DT: appendOne(out, "ld", instr, "DT"); break;
+				case Op::LD_ST: appendOne(out, "ld", instr, "ST"); break;
+				case Op::ADD_I: appendOne(out, "add", instr, "I"); break;
+				case Op::LD_F: appendOne(out, "ld", instr, "F"); break;
+				case Op::LD_B: appendOne(out, "ld", instr, "B"); break;
+				case Op::STORE: appendOne(out, "ld", instr, "[I]"); break;
+				case Op::LOAD: appendOne(out, "ld", instr, nullptr, "[I]"); break;
+				case Op::DATA:
+					out += "    dw ";
+					out += std::to_string(instr.imm);
+					break;
+				case Op::LABEL:
+					out += labels[instr.label];
+					out += ':';
+					break;
+				case Op::COMMENT:
+					if (!comments[instr.label].empty())
+					{
+						out += ";; ";
+						out += comments[instr.label];
+					}
+					break;
+				}
+
+				out += '\n';
+			}
+
+			return out;
+		}
+	} // namespace Chip8
+} // namespace Pascal
@@ -0,0 +1,596 @@
+#include <Chip8Emitter.hpp>
+#include <Intrinsics.hpp>
+
+#include <algorithm>
+
+namespace Pascal
+{
+	using IR::Opcode;
+	using IR::Width;
+	using IR::VReg;
+	using Chip8::Op;
+
+	namespace
+	{
+		const unsigned ScratchReg = 0xC;
+		const unsigned BpReg = 0xD;
+		const unsigned SpReg = 0xE;
+
+		bool isWord(Width width)
+		{
+			return width == Width::WORD;
+		}
+	}
+
+	Chip8Emitter::Chip8Emitter(IR::Module const& module, std::vector<Allocation> const& allocations, bool checkStack)
+		: module(module), allocations(allocations), checkStack(checkStack), usesStack(false), function(nullptr), allocation(nullptr),
+		  staticFrame(-1), currentBlock(0)
+	{ }
+
+	Chip8::Code Chip8Emitter::emit()
+	{
+		std::vector<unsigned> frameSizes;
+		for (auto const& allocation : allocations)
+			frameSizes.push_back(allocation.frameSize);
+
+		CallGraph graph(module);
+		unsigned staticSize = 0;
+		staticFrames = PlaceStaticFrames(graph, frameSizes, staticSize);
+
+		std::vector<unsigned> stackFrameSizes;
+		for (size_t i = 0; i < frameSizes.size(); i++)
+		{
+			if (staticFrames[i] < 0) stackFrameSizes.push_back(frameSizes[i]);
+		}
+		usesStack = !stackFrameSizes.empty();
+
+		// The stack follows the static frames that may be active with it
+		unsigned stackBase = usesStack ? StackBase(graph, staticFrames, frameSizes) : 0;
+		stack = StackAddressing(ChooseStackAddressing(stackFrameSizes).getUnit(), stackBase);
+
+		code = Chip8::Code();
+
+		// Most IR instructions take a few CHIP-8 ones
+		size_t estimate = 0;
+		for (auto const& function : module.functions)
+			for (auto const& block : function.blocks)
+				estimate += block.instrs.size() * 4;
+		code.instrs.reserve(estimate);
+
+		code.addComment(module.name);
+		code.addComment("v0 - spilled first operand and result (low)");
+		code.addComment("v1 - spilled first operand and result (high)");
+		code.addComment("v2 - spilled second operand (low)");
+		code.addComment("v3 - spilled second operand (high)");
+		code.addComment("v4..vB - allocated");
+		code.addComment("vC - scratch");
+		code.addComment("vD - bp");
+		code.addComment("vE - stack pointer");
+		code.addComment("vF - flag");
+		code.addComment("static frames " + std::to_string(staticSize) + " bytes");
+		if (usesStack)
+			code.addComment("stack unit " + std::to_string(stack.getUnit()) + ", stack zone " + std::to_string(stack.zoneSize()) +
+				" bytes from offset " + std::to_string(stack.getBase()));
+		else
+			code.addComment("no stack");
+		code.addComment("");
+
+		for (size_t i = 0; i < module.functions.size(); i++)
+		{
+			staticFrame = staticFrames[i];
+			emitFunction(module.functions[i], allocations[i]);
+		}
+
+		if (checkStack && usesStack)
+		{
+			code.defineLabel("__stack_overflow__");
+			code.add(Op::SYS);
+			code.addAddress(Op::JP, "__stack_overflow__");
+			code.addComment("");
+		}
+
+		code.addComment("global vars");
+		for (unsigned slot = 0; slot < module.globals.count(); slot++)
+		{
+			if (module.globals.sizeOf(slot) == 0) continue;
+
+			code.defineLabel(module.globalNames[slot]);
+			code.add(Op::DATA);
+		}
+
+		code.addComment("");
+		code.defineLabel("BCD_ZONE_LOW");
+		code.add(Op::DATA);
+		code.add(Op::DATA);
+		code.addComment("");
+		code.defineLabel("BCD_ZONE_HIGH");
+		code.add(Op::DATA);
+		code.add(Op::DATA);
+		code.addComment("");
+		code.defineLabel("STACK_ZONE");
+
+		// Static frames overlap where they can, so the deepest chain of
+		// calls needs no more than them. The depth of recursion is not
+		// known, recursive frames may take the whole zone sp addresses,
+		// which -fstack-check keeps them within.
+		code.reserved = staticSize;
+		if (usesStack)
+			code.reserved = std::max(code.reserved, stack.getBase() + stack.zoneSize());
+		code.addComment(std::to_string(code.reserved) + " bytes reserved");
+
+		return std::move(code);
+	}
+
+	StackAddressing Chip8Emitter::ChooseStackAddressing(std::vector<unsigned> const& frameSizes)
+	{
+		// Larger zones don't fit into the memory
+		const unsigned MaxUnit = 8;
+
+		unsigned largest = 0;
+		for (unsigned size : frameSizes)
+			largest = std::max(largest, size);
+
+		for (unsigned unit = 1; unit <= MaxUnit; unit *= 2)
+		{
+			StackAddressing res(unit);
+
+			// Saved bp and the frame of every function
+			unsigned units = 0;
+			for (unsigned size : frameSizes)
+				units += 1 + res.units(size);
+
+			if (units <= 0xFF) return res;
+		}
+
+		// Too many functions to have them all active, at least the largest
+		// frame must be addressable
+		unsigned unit = 1;
+		while (unit < MaxUnit && 1 + StackAddressing(unit).units(largest) > 0xFF)
+			unit *= 2;
+
+		return StackAddressing(unit);
+	}
+
+	std::vector<int> Chip8Emitter::PlaceStaticFrames(CallGraph const& graph, std::vector<unsigned> const& frameSizes, unsigned& size)
+	{
+		size_t count = graph.size();
+		std::vector<int> res(count, -1);
+
+		// Static functions by the number of static functions reaching
+		// them. A caller is reached by fewer, so it comes first.
+		std::vector<unsigned> callers(count, 0);
+		std::vector<unsigned> order;
+		for (unsigned f = 0; f < count; f++)
+		{
+			if (graph.isRecursive(f)) continue;
+
+			for (unsigned g = 0; g < count; g++)
+				if (g != f && !graph.isRecursive(g) && graph.reaches(g, f)) callers[f]++;
+
+			order.push_back(f);
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&callers](unsigned l, unsigned r) {
+			return callers[l] < callers[r];
+		});
+
+		size = 0;
+		for (unsigned f : order)
+		{
+			// Functions reaching this one may be active meanwhile, the
+			// others never are
+			unsigned offset = 0;
+			for (unsigned g : order)
+			{
+				if (res[g] >= 0 && g != f && graph.reaches(g, f))
+					offset = std::max(offset, static_cast<unsigned>(res[g]) + frameSizes[g]);
+			}
+
+			res[f] = static_cast<int>(offset);
+			size = std::max(size, offset + frameSizes[f]);
+		}
+
+		return res;
+	}
+
+	unsigned Chip8Emitter::StackBase(CallGraph const& graph, std::vector<int> const& staticFrames, std::vector<unsigned> const& frameSizes)
+	{
+		unsigned base = 0;
+		for (unsigned f = 0; f < graph.size(); f++)
+		{
+			if (staticFrames[f] < 0) continue;
+
+			// Calls a recursive function or is called by one
+			bool withStack = false;
+			for (unsigned r = 0; r < graph.size() && !withStack; r++)
+				withStack = staticFrames[r] < 0 && (graph.reaches(f, r) || graph.reaches(r, f));
+
+			if (withStack)
+				base = std::max(base, static_cast<unsigned>(staticFrames[f]) + frameSizes[f]);
+		}
+
+		return base;
+	}
+
+	void Chip8Emitter::emitFunction(IR::Function const& function, Allocation const& allocation)
+	{
+		this->function = &function;
+		this->allocation = &allocation;
+
+		code.defineLabel(function.name);
+
+		if (function.isMain())
+		{
+			// The main program is never recursive, its frame is static
+			if (usesStack)
+				code.add(Op::LD_IMM, SpReg, 0, 0);
+		}
+		else if (staticFrame >= 0)
+		{
+			if (allocation.savesRegisters())
+			{
+				frameAddress(allocation.saveOffset);
+				code.add(Op::STORE, allocation.lastRegister);
+			}
+		}
+		else
+		{
+			// push bp
+			stack.loadAddress(code, SpReg, 0, ScratchReg);
+			code.add(Op::LD, 0, BpReg);
+			code.add(Op::STORE, 0);
+			code.add(Op::ADD_IMM, SpReg, 0, 1);
+
+			// mov bp, sp; add sp, size
+			code.add(Op::LD, BpReg, SpReg);
+			if (allocation.frameSize != 0)
+				code.add(Op::ADD_IMM, SpReg, 0, stack.units(allocation.frameSize));
+
+			if (allocation.savesRegisters())
+			{
+				frameAddress(allocation.saveOffset);
+				code.add(Op::STORE, allocation.lastRegister);
+			}
+		}
+
+		for (currentBlock = 0; currentBlock < function.blocks.size(); currentBlock++)
+		{
+			if (currentBlock != 0) code.defineLabel(blockLabel(currentBlock));
+
+			for (auto const& instr : function.blocks[currentBlock].instrs)
+				emitInstr(instr);
+		}
+
+		code.addComment("");
+	}
+
+	void Chip8Emitter::emitInstr(IR::Instr const& instr)
+	{
+		switch (instr.op)
+		{
+		case Opcode::CONST:
+		{
+			Regs dst = def(instr.dst);
+			code.add(Op::LD_IMM, dst.lo, 0, instr.imm & 0xFF);
+			if (isWord(instr.width))
+				code.add(Op::LD_IMM, dst.hi, 0, instr.imm >> 8);
+			finish(instr.dst);
+			break;
+		}
+
+		case Opcode::COPY:
+		case Opcode::EXTEND:
+		case Opcode::TRUNC:
+		{
+			Regs value = use(instr.a);
+			Regs dst = def(instr.dst);
+
+			move(dst.lo, value.lo);
+			if (instr.op == Opcode::EXTEND)
+				code.add(Op::LD_IMM, dst.hi, 0, 0);
+			else if (isWord(instr.width))
+				move(dst.hi, value.hi);
+
+			finish(instr.dst);
+			break;
+		}
+
+		case Opcode::ADD:
+		case Opcode::SUB:
+		case Opcode::NEG:
+			emitArithmetic(instr);
+			break;
+
+		case Opcode::LOAD:
+		{
+			Location const& location = allocation->locations[instr.dst];
+
+			// A parameter spilled to its own slot
+			if (!location.inRegister() && !instr.var.isGlobal() && location.offset == function->frame.offset(instr.var.slot))
+				break;
+
+			address(instr.var);
+			code.add(Op::LOAD, isWord(instr.width) ? 1 : 0);
+
+			Regs dst = def(instr.dst);
+			move(dst.lo, 0);
+			if (isWord(instr.width))
+				move(dst.hi, 1);
+
+			finish(instr.dst);
+			break;
+		}
+
+		case Opcode::STORE:
+		{
+			Regs value = use(instr.a);
+			move(0, value.lo);
+			if (isWord(instr.width))
+				move(1, value.hi);
+
+			address(instr.var);
+			code.add(Op::STORE, isWord(instr.width) ? 1 : 0);
+			break;
+		}
+
+		case Opcode::ARG:
+			pendingArgs.push_back(&instr);
+			break;
+
+		case Opcode::CALL:
+		case Opcode::INTRINSIC:
+			emitCall(instr);
+			break;
+
+		case Opcode::JUMP:
+			if (instr.target != currentBlock + 1)
+				code.addAddress(Op::JP, blockLabel(instr.target));
+			break;
+
+		case Opcode::BRANCH:
+			emitBranch(instr);
+			break;
+
+		case Opcode::RET:
+			emitReturn();
+			break;
+		}
+	}
+
+	void Chip8Emitter::emitArithmetic(IR::Instr const& instr)
+	{
+		bool word = isWord(instr.width);
+
+		if (instr.op == Opcode::NEG)
+		{
+			// 0 - value, vF is 1 when there is no borrow
+			Regs value = use(instr.a);
+			Regs dst = def(instr.dst);
+
+			code.add(Op::LD_IMM, ScratchReg, 0, 0);
+			code.add(Op::SUB, ScratchReg, value.lo);
+			move(dst.lo, ScratchReg);
+			if (word)
+			{
+				code.add(Op::LD_IMM, ScratchReg, 0, 255);
+				code.add(Op::ADD, ScratchReg, 0xF);
+				code.add(Op::SUB, ScratchReg, value.hi);
+				move(dst.hi, ScratchReg);
+			}
+
+			finish(instr.dst);
+			return;
+		}
+
+		Regs right = useSecond(instr.b);
+		Regs left = use(instr.a);
+		Regs dst = def(instr.dst);
+
+		// Computing in place would overwrite the second operand first
+		bool overwrites = instr.dst == instr.b && instr.dst != instr.a && allocation->locations[instr.dst].inRegister();
+		Regs target = overwrites ? Regs{ 0, 1 } : dst;
+
+		Op op = instr.op == Opcode::ADD ? Op::ADD : Op::SUB;
+
+		move(target.lo, left.lo);
+		code.add(op, target.lo, right.lo);
+		if (word)
+		{
+			// ADD: high + carry, SUB: high - 1 + (no borrow)
+			code.add(Op::LD, ScratchReg, 0xF);
+			move(target.hi, left.hi);
+			code.add(op, target.hi, right.hi);
+			code.add(Op::ADD, target.hi, ScratchReg);
+			if (instr.op == Opcode::SUB)
+				code.add(Op::ADD_IMM, target.hi, 0, 255);
+		}
+
+		if (overwrites)
+		{
+			move(dst.lo, target.lo);
+			if (word) move(dst.hi, target.hi);
+		}
+
+		finish(instr.dst);
+	}
+
+	void Chip8Emitter::emitBranch(IR::Instr const& instr)
+	{
+		Regs value = use(instr.a);
+		unsigned tested = value.lo;
+
+		if (isWordReg(instr.a))
+		{
+			move(0, value.lo);
+			code.add(Op::OR, 0, value.hi);
+			tested = 0;
+		}
+
+		if (instr.target == currentBlock + 1)
+		{
+			code.add(Op::SNE_IMM, tested, 0, 0);
+			code.addAddress(Op::JP, blockLabel(instr.elseTarget));
+		}
+		else
+		{
+			code.add(Op::SE_IMM, tested, 0, 0);
+			code.addAddress(Op::JP, blockLabel(instr.target));
+			if (instr.elseTarget != currentBlock + 1)
+				code.addAddress(Op::JP, blockLabel(instr.elseTarget));
+		}
+	}
+
+	void Chip8Emitter::emitCall(IR::Instr const& instr)
+	{
+		if (instr.op == Opcode::INTRINSIC)
+		{
+			// Intrinsics take their argument in v2 and v3
+			for (auto arg : pendingArgs)
+			{
+				Regs value = useSecond(arg->a);
+				move(2, value.lo);
+				if (isWord(arg->width))
+					move(3, value.hi);
+			}
+			pendingArgs.clear();
+
+			Intrinsics[instr.target].emit(code);
+			return;
+		}
+
+		IR::Function const& callee = module.functions[instr.target];
+
+		// The callee's frame, from its saved bp at sp on, must end within
+		// the zone, and its sp past the frame must not wrap to 0
+		if (checkStack && staticFrames[instr.target] < 0)
+		{
+			code.add(Op::LD_IMM, ScratchReg, 0, 254 - stack.units(allocations[instr.target].frameSize));
+			code.add(Op::SUB, ScratchReg, SpReg);
+			code.add(Op::SE_IMM, 0xF, 0, 1);
+			code.addAddress(Op::JP, "__stack_overflow__");
+		}
+
+		// Arguments are placed where the callee's frame will be: after the
+		// unit of the saved bp, at the offsets of its parameters
+		for (auto arg : pendingArgs)
+		{
+			Regs value = use(arg->a);
+			move(0, value.lo);
+			if (isWord(arg->width))
+				move(1, value.hi);
+
+			if (staticFrames[instr.target] >= 0)
+				code.addAddress(Op::LD_I, "STACK_ZONE", static_cast<unsigned>(staticFrames[instr.target]) + callee.frame.offset(arg->index));
+			else
+				stack.loadAddress(code, SpReg, stack.getUnit() + callee.frame.offset(arg->index), ScratchReg);
+			code.add(Op::STORE, isWord(arg->width) ? 1 : 0);
+		}
+		pendingArgs.clear();
+
+		code.addAddress(Op::CALL, callee.name);
+	}
+
+	void Chip8Emitter::emitReturn()
+	{
+		if (function->isMain())
+		{
+			code.defineLabel("__halt__");
+			code.addAddress(Op::JP, "__halt__");
+			return;
+		}
+
+		if (allocation->savesRegisters())
+		{
+			frameAddress(allocation->saveOffset);
+			code.add(Op::LOAD, allocation->lastRegister);
+		}
+
+		if (staticFrame >= 0)
+		{
+			code.add(Op::RET);
+			return;
+		}
+
+		// mov sp, bp; pop bp
+		code.add(Op::LD, SpReg, BpReg);
+		code.add(Op::ADD_IMM, SpReg, 0, 255);
+		stack.loadAddress(code, SpReg, 0, ScratchReg);
+		code.add(Op::LOAD, 0);
+		code.add(Op::LD, BpReg, 0);
+		code.add(Op::RET);
+	}
+
+	Chip8Emitter::Regs Chip8Emitter::use(VReg reg)
+	{
+		Location const& location = allocation->locations[reg];
+		if (location.inRegister())
+			return { location.lo, location.hi };
+
+		frameAddress(location.offset);
+		code.add(Op::LOAD, isWordReg(reg) ? 1 : 0);
+		return { 0, 1 };
+	}
+
+	Chip8Emitter::Regs Chip8Emitter::useSecond(VReg reg)
+	{
+		if (allocation->locations[reg].inRegister())
+			return use(reg);
+
+		use(reg);
+		code.add(Op::LD, 2, 0);
+		if (isWordReg(reg))
+			code.add(Op::LD, 3, 1);
+
+		return { 2, 3 };
+	}
+
+	Chip8Emitter::Regs Chip8Emitter::def(VReg reg)
+	{
+		Location const& location = allocation->locations[reg];
+		if (location.inRegister())
+			return { location.lo, location.hi };
+
+		return { 0, 1 };
+	}
+
+	void Chip8Emitter::finish(VReg reg)
+	{
+		Location const& location = allocation->locations[reg];
+		if (location.inRegister()) return;
+
+		frameAddress(location.offset);
+		code.add(Op::STORE, isWordReg(reg) ? 1 : 0);
+	}
+
+	void Chip8Emitter::move(unsigned to, unsigned from)
+	{
+		if (to != from)
+			code.add(Op::LD, to, from);
+	}
+
+	bool Chip8Emitter::isWordReg(VReg reg) const
+	{
+		return function->vregs[reg] == Width::WORD;
+	}
+
+	void Chip8Emitter::address(IR::Var var)
+	{
+		if (var.isGlobal())
+			code.addAddress(Op::LD_I, module.globalNames[var.slot]);
+		else
+			frameAddress(function->frame.offset(var.slot));
+	}
+
+	void Chip8Emitter::frameAddress(unsigned offset)
+	{
+		if (staticFrame >= 0)
+			code.addAddress(Op::LD_I, "STACK_ZONE", static_cast<unsigned>(staticFrame) + offset);
+		else
+			stack.loadAddress(code, BpReg, offset, ScratchReg);
+	}
+
+	std::string Chip8Emitter::blockLabel(unsigned block) const
+	{
+		return function->name + "__bb" + std::to_string(block);
+	}
+} // namespace Pascal
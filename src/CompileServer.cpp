@@ -0,0 +1,346 @@
+#include <CompileServer.hpp>
+#include <Driver.hpp>
+#include <ReportsManager.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace Pascal
+{
+	namespace
+	{
+		// Limits of a request, larger ones are dropped without a response
+		const uint32_t MaxFieldSize = 16 * 1024 * 1024;
+		const unsigned MaxArgs = 1024;
+
+		// A client that stalls for longer is dropped
+		const long ReceiveTimeoutSeconds = 10;
+
+		void printError(std::string const& msg)
+		{
+			std::cout << TermColor::BrightRed << "error" << TermColor::BrightWhite <<
+				": " << msg << TermColor::Reset << std::endl;
+		}
+
+#if !defined(_WIN32)
+		bool writeAll(int fd, const char* data, size_t size)
+		{
+			while (size > 0)
+			{
+				ssize_t written = ::write(fd, data, size);
+				if (written <= 0) return false;
+
+				data += written;
+				size -= written;
+			}
+			return true;
+		}
+
+		bool readAll(int fd, char* data, size_t size)
+		{
+			while (size > 0)
+			{
+				ssize_t got = ::read(fd, data, size);
+				if (got <= 0) return false;
+
+				data += got;
+				size -= got;
+			}
+			return true;
+		}
+
+		void putField(std::string& buffer, std::string const& field)
+		{
+			uint32_t size = static_cast<uint32_t>(field.size());
+			for (int i = 0; i < 4; i++)
+				buffer += static_cast<char>((size >> (i * 8)) & 0xFF);
+			buffer += field;
+		}
+
+		bool getField(int fd, std::string& field)
+		{
+			unsigned char header[4];
+			if (!readAll(fd, reinterpret_cast<char*>(header), 4)) return false;
+
+			uint32_t size = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+			if (size > MaxFieldSize) return false;
+
+			field.assign(size, '\0');
+			return size == 0 || readAll(fd, &field[0], size);
+		}
+
+		bool makeAddress(std::string const& path, sockaddr_un& addr)
+		{
+			if (path.size() >= sizeof(addr.sun_path))
+			{
+				printError("socket path is too long \"" + path + "\"");
+				return false;
+			}
+
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			std::strcpy(addr.sun_path, path.c_str());
+			return true;
+		}
+
+		// Removes the socket file left by a server that wasn't shut down
+		// properly. Anything else at the path, a regular file or a socket
+		// some server still accepts on, is left alone.
+		bool removeStaleSocket(std::string const& path, sockaddr_un const& addr)
+		{
+			struct stat info;
+			if (::lstat(path.c_str(), &info) != 0)
+			{
+				if (errno == ENOENT) return true;
+
+				printError("can't access \"" + path + "\"");
+				return false;
+			}
+
+			if (!S_ISSOCK(info.st_mode))
+			{
+				printError("\"" + path + "\" exists and is not a socket");
+				return false;
+			}
+
+			int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (probe < 0)
+			{
+				printError("can't create socket");
+				return false;
+			}
+
+			bool refused = ::connect(probe, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) != 0 &&
+				errno == ECONNREFUSED;
+			::close(probe);
+
+			if (!refused)
+			{
+				printError("a compile server is already listening on \"" + path + "\"");
+				return false;
+			}
+
+			return ::unlink(path.c_str()) == 0;
+		}
+#endif
+	}
+
+	CompileServer::CompileServer(std::string const& socketPath)
+		: socketPath(socketPath)
+	{ }
+
+#if defined(_WIN32)
+	int CompileServer::run()
+	{
+		printError("compile server is not supported on this platform");
+		return 2;
+	}
+
+	bool CompileServer::handle(int connection)
+	{
+		return false;
+	}
+
+	int CompileServer::RunClient(std::string const& socketPath, std::vector<std::string> const& args)
+	{
+		printError("compile server is not supported on this platform");
+		return 2;
+	}
+#else
+	int CompileServer::run()
+	{
+		sockaddr_un addr;
+		if (!makeAddress(socketPath, addr)) return 2;
+
+		// Clients that go away before reading the response must not kill the server
+		std::signal(SIGPIPE, SIG_IGN);
+
+		int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listener < 0)
+		{
+			printError("can't create socket");
+			return 2;
+		}
+
+		if (!removeStaleSocket(socketPath, addr))
+		{
+			::close(listener);
+			return 2;
+		}
+
+		if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+			|| ::listen(listener, 16) != 0)
+		{
+			printError("can't listen on \"" + socketPath + "\"");
+			::close(listener);
+			return 2;
+		}
+
+		bool serving = true;
+		while (serving)
+		{
+			int connection = ::accept(listener, nullptr, nullptr);
+			if (connection < 0) continue;
+
+			timeval timeout = { ReceiveTimeoutSeconds, 0 };
+			::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+			serving = handle(connection);
+			::close(connection);
+		}
+
+		::close(listener);
+		::unlink(socketPath.c_str());
+		return 0;
+	}
+
+	bool CompileServer::handle(int connection)
+	{
+		std::string field;
+		if (!getField(connection, field)) return true;
+
+		unsigned argc = static_cast<unsigned>(std::strtoul(field.c_str(), nullptr, 10));
+		if (argc > MaxArgs) return true;
+
+		std::vector<std::string> args;
+		for (unsigned i = 0; i < argc; i++)
+		{
+			if (!getField(connection, field)) return true;
+			args.push_back(field);
+		}
+
+		std::string fileName;
+		std::shared_ptr<std::string> source = std::make_shared<std::string>();
+		if (!getField(connection, fileName) || !getField(connection, *source)) return true;
+
+		std::string response;
+
+		if (std::find(args.begin(), args.end(), "--shutdown") != args.end())
+		{
+			putField(response, "0");
+			putField(response, "");
+			putField(response, "");
+			writeAll(connection, response.data(), response.size());
+			return false;
+		}
+
+		// A failing compilation must not take the server down
+		ReportsContext* previousReports = ReportsManager::GetContext();
+		try
+		{
+			Driver driver(args);
+			std::stringstream diagnostics;
+			int status = driver.compile(fileName, source, diagnostics);
+
+			putField(response, std::to_string(status));
+			putField(response, diagnostics.str());
+			putField(response, driver.getOutput());
+		}
+		catch (std::exception const& e)
+		{
+			ReportsManager::SetContext(previousReports);
+
+			response.clear();
+			putField(response, "2");
+			putField(response, std::string("error: internal compiler error: ") + e.what() + "\n");
+			putField(response, "");
+		}
+
+		writeAll(connection, response.data(), response.size());
+
+		return true;
+	}
+
+	int CompileServer::RunClient(std::string const& socketPath, std::vector<std::string> const& args)
+	{
+		bool shutdown = std::find(args.begin(), args.end(), "--shutdown") != args.end();
+
+		std::string inFileName = Driver::GetInputFileName(args);
+		std::string outFileName = Driver::GetOutputFileName(args);
+
+		if (outFileName.empty())
+		{
+			printError("expected output file name");
+			return 2;
+		}
+
+		std::string source;
+		if (!shutdown)
+		{
+			std::ifstream fin(inFileName);
+			if (!fin.is_open())
+			{
+				printError("can't open file \"" + inFileName + "\"");
+				return 2;
+			}
+
+			std::stringstream ss;
+			ss << fin.rdbuf();
+			source = ss.str();
+		}
+
+		sockaddr_un addr;
+		if (!makeAddress(socketPath, addr)) return 2;
+
+		int connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (connection < 0 || ::connect(connection, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+		{
+			printError("can't connect to compile server at \"" + socketPath + "\"");
+			if (connection >= 0) ::close(connection);
+			return 2;
+		}
+
+		std::string request;
+		putField(request, std::to_string(args.size()));
+		for (auto const& arg : args)
+			putField(request, arg);
+		putField(request, inFileName);
+		putField(request, source);
+
+		std::string status, diagnostics, output;
+		bool ok = writeAll(connection, request.data(), request.size())
+			&& getField(connection, status)
+			&& getField(connection, diagnostics)
+			&& getField(connection, output);
+
+		::close(connection);
+
+		if (!ok)
+		{
+			printError("compile server closed the connection");
+			return 2;
+		}
+
+		std::cout << diagnostics << std::flush;
+
+		if (!output.empty())
+		{
+			std::ofstream fout(outFileName, std::ios::out | std::ios::binary);
+			if (!fout.is_open())
+			{
+				printError("couldn't open file \"" + outFileName + "\"");
+				return 2;
+			}
+			fout.write(output.data(), output.size());
+		}
+
+		return std::atoi(status.c_str());
+	}
+#endif
+} // namespace Pascal
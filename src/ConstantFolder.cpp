@@ -0,0 +1,326 @@
+#include <ConstantFolder.hpp>
+
+#include <AST.hpp>
+#include <TreeWalker.hpp>
+
+#include <iterator>
+#include <utility>
+#include <string>
+#include <vector>
+
+namespace Pascal
+{
+	using IR::Opcode;
+	using IR::Width;
+	using IR::VReg;
+
+	namespace
+	{
+		// Post-order callback of TreeWalker, the operands of an operation
+		// are on top of `values` when it is visited
+		class Evaluator : public EmptyVisitor
+		{
+		public:
+			Evaluator(uint16_t mask)
+				: mask(mask), constant(true)
+			{ }
+
+			uint16_t mask;
+			bool constant;
+			std::vector<uint16_t> values;
+
+			void visitVarNode(const AST::VarNode& node)
+			{
+				// Zero-extended or truncated like a variable of the type
+				if (node.symbol.hasValue)
+					values.push_back(static_cast<uint16_t>(node.symbol.value & mask));
+				else
+					unknown();
+			}
+
+			void visitIntLiteralNode(const AST::IntLiteralNode& node)
+			{
+				unsigned long literal = 0;
+
+				try
+				{
+					literal = std::stoul(node.token.str);
+				}
+				catch (...)
+				{
+					literal = 0x10000;
+				}
+
+				if (literal > 0xFFFF)
+					unknown();
+				else
+					values.push_back(static_cast<uint16_t>(literal & mask));
+			}
+
+			void visitBinaryExprNode(const AST::BinaryExprNode& node)
+			{
+				uint16_t right = values.back();
+				values.pop_back();
+				uint16_t left = values.back();
+
+				switch (node.op.type)
+				{
+				case TokenType::PLUS:
+					values.back() = static_cast<uint16_t>((left + right) & mask);
+					break;
+				case TokenType::MINUS:
+					values.back() = static_cast<uint16_t>((left - right) & mask);
+					break;
+
+				default:
+					constant = false;
+					break;
+				}
+			}
+
+			void visitUnaryExprNode(const AST::UnaryExprNode& node)
+			{
+				if (node.op.type == TokenType::MINUS)
+					values.back() = static_cast<uint16_t>((0 - values.back()) & mask);
+			}
+
+			void visitFunctionCall(const AST::FunctionCallNode&)
+			{
+				unknown();
+			}
+
+		private:
+			void unknown()
+			{
+				constant = false;
+				values.push_back(0);
+			}
+		};
+
+		uint16_t maskOf(Width width)
+		{
+			return width == Width::WORD ? 0xFFFF : 0xFF;
+		}
+	}
+
+	bool EvaluateConstant(const AST::ExpressionNode& expr, SymType type, uint16_t& value)
+	{
+		Evaluator evaluator(maskOf(IR::WidthOf(type)));
+		TreeWalker walker(nullptr, &evaluator);
+		walker.walk(expr);
+
+		value = evaluator.values.back();
+		return evaluator.constant;
+	}
+
+	void ConstantFolder::run(IR::Function& function)
+	{
+		defs.assign(function.vregs.size(), nullptr);
+		uses.assign(function.vregs.size(), 0);
+
+		for (auto const& block : function.blocks)
+		{
+			for (auto const& instr : block.instrs)
+			{
+				if (instr.a != IR::NoReg) uses[instr.a]++;
+				if (instr.b != IR::NoReg) uses[instr.b]++;
+			}
+		}
+
+		// Taken before branches are folded, edges may only go away
+		std::vector<std::vector<unsigned>> preds = Predecessors(function);
+		std::vector<Stored> storedAtEnd(function.blocks.size());
+
+		// Instructions are folded in order, their operands are final by then.
+		// Blocks don't change size until every one is folded.
+		for (unsigned b = 0; b < function.blocks.size(); b++)
+		{
+			Stored stored;
+			if (preds[b].size() == 1 && preds[b][0] < b)
+				stored = storedAtEnd[preds[b][0]];
+
+			for (auto& instr : function.blocks[b].instrs)
+			{
+				forward(instr, stored);
+				fold(instr);
+				if (instr.dst != IR::NoReg) defs[instr.dst] = &instr;
+			}
+
+			storedAtEnd[b] = std::move(stored);
+		}
+
+		IR::RemoveDeadValues(function);
+	}
+
+	std::vector<std::vector<unsigned>> ConstantFolder::Predecessors(IR::Function const& function)
+	{
+		std::vector<std::vector<unsigned>> res(function.blocks.size());
+
+		for (unsigned b = 0; b < function.blocks.size(); b++)
+		{
+			if (function.blocks[b].instrs.empty()) continue;
+
+			IR::Instr const& last = function.blocks[b].terminator();
+			if (last.op == Opcode::JUMP || last.op == Opcode::BRANCH)
+				res[last.target].push_back(b);
+			if (last.op == Opcode::BRANCH && last.elseTarget != last.target)
+				res[last.elseTarget].push_back(b);
+		}
+
+		return res;
+	}
+
+	void ConstantFolder::forward(IR::Instr& instr, Stored& stored)
+	{
+		uint16_t value = 0;
+
+		switch (instr.op)
+		{
+		case Opcode::LOAD:
+		{
+			auto it = stored.find(varKey(instr.var));
+			if (it != stored.end() && it->second->width == instr.width && constantOf(it->second->a, value))
+			{
+				instr.var = IR::Var();
+				makeConstant(instr, value);
+			}
+			break;
+		}
+
+		case Opcode::STORE:
+			if (constantOf(instr.a, value))
+				stored[varKey(instr.var)] = &instr;
+			else
+				stored.erase(varKey(instr.var));
+			break;
+
+		// Callees may assign globals, never the frame of the caller
+		case Opcode::CALL:
+			for (auto it = stored.begin(); it != stored.end();)
+				it = it->first % 2 != 0 ? stored.erase(it) : std::next(it);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	void ConstantFolder::fold(IR::Instr& instr)
+	{
+		uint16_t mask = maskOf(instr.width);
+		uint16_t a = 0, b = 0;
+
+		switch (instr.op)
+		{
+		case Opcode::COPY:
+		case Opcode::EXTEND:
+		case Opcode::TRUNC:
+			if (constantOf(instr.a, a))
+				makeConstant(instr, static_cast<uint16_t>(a & mask));
+			break;
+
+		case Opcode::NEG:
+			if (constantOf(instr.a, a))
+				makeConstant(instr, static_cast<uint16_t>((0 - a) & mask));
+			break;
+
+		case Opcode::ADD:
+		case Opcode::SUB:
+		{
+			bool knownA = constantOf(instr.a, a);
+			bool knownB = constantOf(instr.b, b);
+
+			if (knownA && knownB)
+			{
+				makeConstant(instr, static_cast<uint16_t>((instr.op == Opcode::ADD ? a + b : a - b) & mask));
+				break;
+			}
+
+			// c + x is x + c
+			if (knownA && instr.op == Opcode::ADD)
+				std::swap(instr.a, instr.b);
+
+			IR::Instr* constant = ownConstant(instr.b);
+			if (constant == nullptr)
+				break;
+
+			// x - c is x + (-c)
+			if (instr.op == Opcode::SUB)
+			{
+				instr.op = Opcode::ADD;
+				constant->imm = static_cast<uint16_t>((0 - constant->imm) & mask);
+			}
+
+			// (y + c1) + c2 is y + (c1 + c2), the inner add is dropped when
+			// nothing else reads it
+			IR::Instr* inner = defs[instr.a];
+			uint16_t c1 = 0;
+			if (inner != nullptr && inner->op == Opcode::ADD && inner->width == instr.width &&
+				uses[instr.a] == 1 && constantOf(inner->b, c1))
+			{
+				constant->imm = static_cast<uint16_t>((constant->imm + c1) & mask);
+
+				VReg y = inner->a;
+				uses[y]++;
+				release(instr.a);
+				instr.a = y;
+			}
+
+			if (constant->imm == 0)
+			{
+				instr.op = Opcode::COPY;
+				release(instr.b);
+				instr.b = IR::NoReg;
+			}
+			break;
+		}
+
+		case Opcode::BRANCH:
+			if (constantOf(instr.a, a))
+			{
+				instr.op = Opcode::JUMP;
+				if (a == 0) instr.target = instr.elseTarget;
+				release(instr.a);
+				instr.a = IR::NoReg;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	bool ConstantFolder::constantOf(VReg reg, uint16_t& value) const
+	{
+		if (reg == IR::NoReg || defs[reg] == nullptr || defs[reg]->op != Opcode::CONST)
+			return false;
+
+		value = defs[reg]->imm;
+		return true;
+	}
+
+	IR::Instr* ConstantFolder::ownConstant(VReg reg) const
+	{
+		uint16_t value = 0;
+		if (!constantOf(reg, value) || uses[reg] != 1)
+			return nullptr;
+
+		return defs[reg];
+	}
+
+	void ConstantFolder::makeConstant(IR::Instr& instr, uint16_t value)
+	{
+		release(instr.a);
+		release(instr.b);
+
+		instr.op = Opcode::CONST;
+		instr.a = IR::NoReg;
+		instr.b = IR::NoReg;
+		instr.imm = value;
+	}
+
+	void ConstantFolder::release(VReg reg)
+	{
+		if (reg != IR::NoReg) uses[reg]--;
+	}
+} // namespace Pascal
@@ -0,0 +1,414 @@
+#include <DeadCodeEliminator.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+namespace Pascal
+{
+	using IR::Opcode;
+	using IR::VReg;
+
+	namespace
+	{
+		std::vector<unsigned> successors(IR::BasicBlock const& block)
+		{
+			IR::Instr const& last = block.terminator();
+			switch (last.op)
+			{
+			case Opcode::JUMP:
+				return { last.target };
+			case Opcode::BRANCH:
+				return { last.target, last.elseTarget };
+			default:
+				return {};
+			}
+		}
+
+		void unite(std::vector<bool>& to, std::vector<bool> const& from, size_t offset = 0)
+		{
+			for (size_t i = 0; i < from.size(); i++)
+				if (from[i]) to[offset + i] = true;
+		}
+
+		unsigned varKey(IR::Var var)
+		{
+			return var.slot * 2 + (var.isGlobal() ? 1 : 0);
+		}
+	}
+
+	DeadCodeEliminator::DeadCodeEliminator()
+		: blocksRemoved(0), functionsRemoved(0), storesRemoved(0),
+		  globalsRemoved(0), localsRemoved(0)
+	{ }
+
+	void DeadCodeEliminator::run(IR::Module& module)
+	{
+		for (auto& function : module.functions)
+			removeUnreachableBlocks(function);
+
+		removeUncalledFunctions(module);
+
+		for (auto& function : module.functions)
+			forwardStores(function);
+
+		// Dropping a store may leave a global unread, whose stores are
+		// dropped in the next round
+		unsigned before = 0;
+		do
+		{
+			before = storesRemoved;
+			collectGlobalReads(module);
+
+			for (auto& function : module.functions)
+				removeDeadStores(module, function);
+		} while (storesRemoved != before);
+
+		removeUnreadStorage(module);
+	}
+
+	void DeadCodeEliminator::printStats(std::ostream& out, unsigned romSaved) const
+	{
+		out << "Dead code: " << functionsRemoved << " procedures, "
+			<< blocksRemoved << " blocks, "
+			<< storesRemoved << " stores, "
+			<< globalsRemoved << " globals and "
+			<< localsRemoved << " locals removed, "
+			<< romSaved << " bytes of ROM saved." << std::endl;
+	}
+
+	void DeadCodeEliminator::removeUnreachableBlocks(IR::Function& function)
+	{
+		size_t count = function.blocks.size();
+
+		std::vector<bool> reached(count, false);
+		std::vector<unsigned> worklist(1, 0);
+		reached[0] = true;
+
+		while (!worklist.empty())
+		{
+			unsigned block = worklist.back();
+			worklist.pop_back();
+
+			for (unsigned next : successors(function.blocks[block]))
+			{
+				if (reached[next]) continue;
+				reached[next] = true;
+				worklist.push_back(next);
+			}
+		}
+
+		// Blocks keep their order, targets are renumbered
+		std::vector<unsigned> number(count, 0);
+		std::vector<IR::BasicBlock> kept;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!reached[i])
+			{
+				blocksRemoved++;
+				continue;
+			}
+
+			number[i] = static_cast<unsigned>(kept.size());
+			kept.push_back(std::move(function.blocks[i]));
+		}
+
+		for (auto& block : kept)
+		{
+			IR::Instr& last = block.instrs.back();
+			if (last.op == Opcode::JUMP || last.op == Opcode::BRANCH)
+			{
+				last.target = number[last.target];
+				last.elseTarget = number[last.elseTarget];
+			}
+		}
+
+		function.blocks = std::move(kept);
+	}
+
+	void DeadCodeEliminator::removeUncalledFunctions(IR::Module& module)
+	{
+		size_t count = module.functions.size();
+
+		std::vector<bool> called(count, false);
+		std::vector<unsigned> worklist(1, 0);
+		called[0] = true;
+
+		while (!worklist.empty())
+		{
+			unsigned function = worklist.back();
+			worklist.pop_back();
+
+			for (auto const& block : module.functions[function].blocks)
+			{
+				for (auto const& instr : block.instrs)
+				{
+					if (instr.op != Opcode::CALL || called[instr.target]) continue;
+					called[instr.target] = true;
+					worklist.push_back(instr.target);
+				}
+			}
+		}
+
+		std::vector<unsigned> number(count, 0);
+		std::vector<IR::Function> kept;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!called[i])
+			{
+				functionsRemoved++;
+				continue;
+			}
+
+			number[i] = static_cast<unsigned>(kept.size());
+			kept.push_back(std::move(module.functions[i]));
+		}
+
+		for (auto& function : kept)
+			for (auto& block : function.blocks)
+				for (auto& instr : block.instrs)
+					if (instr.op == Opcode::CALL) instr.target = number[instr.target];
+
+		module.functions = std::move(kept);
+	}
+
+	void DeadCodeEliminator::collectGlobalReads(IR::Module const& module)
+	{
+		size_t count = module.functions.size();
+		globalReads.assign(count, std::vector<bool>(module.globals.count(), false));
+
+		for (size_t i = 0; i < count; i++)
+			for (auto const& block : module.functions[i].blocks)
+				for (auto const& instr : block.instrs)
+					if (instr.op == Opcode::LOAD && instr.var.isGlobal()) globalReads[i][instr.var.slot] = true;
+
+		// Callees' reads, until recursive calls settle
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				std::vector<bool> reads = globalReads[i];
+				for (auto const& block : module.functions[i].blocks)
+					for (auto const& instr : block.instrs)
+						if (instr.op == Opcode::CALL) unite(reads, globalReads[instr.target]);
+
+				if (reads != globalReads[i])
+				{
+					globalReads[i] = std::move(reads);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	void DeadCodeEliminator::forwardStores(IR::Function& function)
+	{
+		// Registers the dropped loads are replaced by
+		std::vector<VReg> replaced(function.vregs.size(), IR::NoReg);
+		auto resolve = [&replaced](VReg reg)
+		{
+			while (reg != IR::NoReg && replaced[reg] != IR::NoReg)
+				reg = replaced[reg];
+			return reg;
+		};
+
+		for (auto& block : function.blocks)
+		{
+			// Register holding the value of a variable, by varKey()
+			std::unordered_map<unsigned, VReg> held;
+			std::vector<IR::Instr> kept;
+			kept.reserve(block.instrs.size());
+
+			for (auto& instr : block.instrs)
+			{
+				instr.a = resolve(instr.a);
+				instr.b = resolve(instr.b);
+
+				if (instr.op == Opcode::LOAD)
+				{
+					auto it = held.find(varKey(instr.var));
+					if (it != held.end())
+					{
+						replaced[instr.dst] = it->second;
+						continue;
+					}
+					held[varKey(instr.var)] = instr.dst;
+				}
+				else if (instr.op == Opcode::STORE)
+				{
+					// Writes back the value the variable already has
+					auto it = held.find(varKey(instr.var));
+					if (it != held.end() && it->second == instr.a)
+					{
+						storesRemoved++;
+						continue;
+					}
+					held[varKey(instr.var)] = instr.a;
+				}
+				else if (instr.op == Opcode::CALL)
+				{
+					// Callees may write any global
+					for (auto it = held.begin(); it != held.end(); )
+						it = it->first % 2 != 0 ? held.erase(it) : std::next(it);
+				}
+
+				kept.push_back(instr);
+			}
+
+			block.instrs = std::move(kept);
+		}
+
+		// Blocks before the load in the list may still read it
+		for (auto& block : function.blocks)
+		{
+			for (auto& instr : block.instrs)
+			{
+				instr.a = resolve(instr.a);
+				instr.b = resolve(instr.b);
+			}
+		}
+	}
+
+	void DeadCodeEliminator::removeDeadStores(IR::Module const& module, IR::Function& function)
+	{
+		// Variables are numbered frame slots first, then globals
+		size_t frameSlots = function.frame.count();
+		size_t slots = frameSlots + module.globals.count();
+
+		auto index = [frameSlots](IR::Var var)
+		{
+			return var.isGlobal() ? frameSlots + var.slot : var.slot;
+		};
+
+		// After a procedure returns, its callers may read any global they
+		// or their callees read. Nothing runs after the main program.
+		std::vector<bool> atExit(slots, false);
+		if (!function.isMain())
+			for (auto const& reads : globalReads)
+				unite(atExit, reads, frameSlots);
+
+		// Variables read later on some path, at the end of every block
+		size_t count = function.blocks.size();
+		std::vector<std::vector<bool>> liveIn(count, std::vector<bool>(slots, false));
+
+		auto liveOut = [&](IR::BasicBlock const& block)
+		{
+			if (block.terminator().op == Opcode::RET)
+				return atExit;
+
+			std::vector<bool> live(slots, false);
+			for (unsigned next : successors(block))
+				unite(live, liveIn[next]);
+			return live;
+		};
+
+		// Walks a block backwards, `remove` drops stores of dead variables
+		auto transfer = [&](IR::BasicBlock& block, bool remove)
+		{
+			std::vector<bool> live = liveOut(block);
+			std::vector<IR::Instr> kept;
+
+			for (auto it = block.instrs.rbegin(); it != block.instrs.rend(); ++it)
+			{
+				if (it->op == Opcode::LOAD)
+				{
+					live[index(it->var)] = true;
+				}
+				else if (it->op == Opcode::STORE)
+				{
+					if (remove && !live[index(it->var)])
+					{
+						storesRemoved++;
+						continue;
+					}
+					live[index(it->var)] = false;
+				}
+				else if (it->op == Opcode::CALL)
+				{
+					unite(live, globalReads[it->target], frameSlots);
+				}
+
+				if (remove) kept.push_back(*it);
+			}
+
+			if (remove)
+			{
+				std::reverse(kept.begin(), kept.end());
+				block.instrs = std::move(kept);
+			}
+
+			return live;
+		};
+
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+
+			for (size_t i = count; i-- > 0; )
+			{
+				std::vector<bool> live = transfer(function.blocks[i], false);
+				if (live != liveIn[i])
+				{
+					liveIn[i] = std::move(live);
+					changed = true;
+				}
+			}
+		}
+
+		for (auto& block : function.blocks)
+			transfer(block, true);
+
+		IR::RemoveDeadValues(function);
+	}
+
+	void DeadCodeEliminator::removeUnreadStorage(IR::Module& module)
+	{
+		std::vector<bool> read(module.globals.count(), false);
+		for (auto const& reads : globalReads)
+			unite(read, reads);
+
+		// Procedures take no space already
+		FrameLayout globals;
+		for (unsigned slot = 0; slot < module.globals.count(); slot++)
+		{
+			unsigned size = module.globals.sizeOf(slot);
+			if (size != 0 && !read[slot])
+			{
+				globalsRemoved++;
+				size = 0;
+			}
+
+			globals.add(size);
+		}
+		module.globals = globals;
+
+		for (auto& function : module.functions)
+		{
+			if (function.isMain()) continue;
+
+			std::vector<bool> loaded(function.frame.count(), false);
+			for (auto const& block : function.blocks)
+				for (auto const& instr : block.instrs)
+					if (instr.op == Opcode::LOAD && !instr.var.isGlobal()) loaded[instr.var.slot] = true;
+
+			// Callers place the arguments, parameters stay
+			FrameLayout frame;
+			for (unsigned slot = 0; slot < function.frame.count(); slot++)
+			{
+				unsigned size = function.frame.sizeOf(slot);
+				if (slot >= function.signature->params.size() && size != 0 && !loaded[slot])
+				{
+					localsRemoved++;
+					size = 0;
+				}
+
+				frame.add(size);
+			}
+			function.frame = frame;
+		}
+	}
+} // namespace Pascal
@@ -0,0 +1,326 @@
+#include <Driver.hpp>
+
+#include <ReportsManager.hpp>
+#include <Scanner.hpp>
+#include <Parser.hpp>
+#include <AST.hpp>
+#include <TreeWalker.hpp>
+#include <AnalysisCache.hpp>
+
+#include <UndeclRedefinitionVisitor.hpp>
+#include <UsedInitializedVisitor.hpp>
+#include <SemanticAnalyzer.hpp>
+#include <IRBuilder.hpp>
+#include <CallGraph.hpp>
+#include <ConstantFolder.hpp>
+#include <DeadCodeEliminator.hpp>
+#include <RegisterAllocator.hpp>
+#include <Chip8Emitter.hpp>
+#include <PeepholeOptimizer.hpp>
+#include <Inliner.hpp>
+#include <Chip8Assembler.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace Pascal
+{
+	namespace
+	{
+		// Options followed by a separate value
+		bool takesValue(std::string const& arg)
+		{
+			return arg == "-o" || arg == "-j" || arg == "--server" || arg == "--client";
+		}
+
+		// Bytes of the assembled program, even if it doesn't fit
+		unsigned RomSize(Chip8::Code const& code)
+		{
+			Chip8Assembler assembler;
+			assembler.assemble(code);
+			return assembler.getSize();
+		}
+	}
+
+	Driver::Driver(std::vector<std::string> const& args)
+		: args(args)
+	{ }
+
+	int Driver::compile(std::string const& fileName, std::shared_ptr<std::string> source,
+						std::ostream& diagnostics)
+	{
+		ReportsContext* previousReports = ReportsManager::GetContext();
+		ReportsManager::SetContext(&reports);
+
+		ReportsManager::Reset();
+		ReportsManager::Init(args);
+		ReportsManager::SetOutput(&diagnostics);
+
+		output.clear();
+
+		std::unique_ptr<AnalysisCache> cache;
+		for (auto const& arg : args)
+		{
+			if (arg.rfind("-fcache-dir=", 0) == 0)
+			{
+				cache = std::make_unique<AnalysisCache>(arg.substr(12), args);
+			}
+		}
+
+		std::unique_ptr<AST::ProgramNode> tree;
+
+		ReportsManager::SetCurrentFile({ fileName, source });
+
+		try
+		{
+			{
+				Scanner scanner(source);
+				TokenList tokens = scanner.scanTokens();
+				Parser parser(tokens);
+				tree = parser.parseProgram();
+			}
+
+			if (ReportsManager::GetErrorsCount() == 0)
+			{
+				if (cache != nullptr)
+				{
+					ReportsManager::SetListener(cache.get());
+					cache->prepare(*tree);
+				}
+
+				runPasses(*tree, cache.get(), diagnostics);
+			}
+		}
+		catch (StopExecution const& e)
+		{
+
+		}
+
+		ReportsManager::Flush();
+
+		if (cache != nullptr)
+		{
+			ReportsManager::SetListener(nullptr);
+
+			// Only results of complete and successful analysis are stored
+			if (ReportsManager::GetErrorsCount() == 0)
+				cache->commit();
+
+			if (std::find(args.begin(), args.end(), "-fcache-stats") != args.end())
+				cache->printStats(diagnostics);
+		}
+
+		releaseTree(std::move(tree));
+
+		unsigned warnings = ReportsManager::GetWarningsCount();
+		unsigned errors = ReportsManager::GetErrorsCount();
+
+		// Machine readable output must stay parsable
+		if (ReportsManager::GetFormat() == DiagnosticsFormat::TEXT)
+		{
+			if (warnings > 0)
+			{
+				if (errors > 0)
+					diagnostics << "Generated " << warnings << " warnings and " << errors << " errors." << std::endl;
+				else
+					diagnostics << "Generated " << warnings << " warnings." << std::endl;
+			}
+			else if (errors > 0)
+				diagnostics << "Generated " << errors << " errors." << std::endl;
+		}
+
+		ReportsManager::SetContext(previousReports);
+
+		return errors > 0 ? 1 : 0;
+	}
+
+	void Driver::runPasses(AST::ProgramNode const& tree, AnalysisCache* cache, std::ostream& diagnostics)
+	{
+		UndeclRedefinitionVisitor undeclPass(types);
+		undeclPass.run(tree);
+
+		if (ReportsManager::GetErrorsCount() != 0)
+			return;
+
+		SemanticAnalyzer semanticAnalyzer;
+		semanticAnalyzer.run(tree);
+
+		if (ReportsManager::GetErrorsCount() != 0)
+			return;
+
+		UsedInitializedVisitor usedPass(cache);
+		usedPass.run(tree);
+
+		if (ReportsManager::GetErrorsCount() != 0)
+			return;
+
+		IRBuilder builder;
+		IR::Module module = builder.build(tree);
+
+		if (ReportsManager::GetErrorsCount() != 0)
+			return;
+
+		// No stack is deep enough for these
+		CallGraph graph(module);
+		for (unsigned f = 0; f < graph.size(); f++)
+		{
+			if (graph.isRecursive(f) && !graph.mayReturn(f))
+			{
+				ReportsManager::ReportError(module.functions[f].pos, "procedure '" + module.functions[f].name +
+					"' calls itself on every path, its recursion is unbounded");
+			}
+		}
+
+		if (ReportsManager::GetErrorsCount() != 0)
+			return;
+
+		if (std::find(args.begin(), args.end(), "-fno-inline") == args.end())
+		{
+			bool size = std::find(args.begin(), args.end(), "-Os") != args.end();
+
+			Inliner inliner(size ? Inliner::Goal::SIZE : Inliner::Goal::SPEED);
+			inliner.run(module);
+
+			if (std::find(args.begin(), args.end(), "-finline-stats") != args.end())
+				inliner.printStats(diagnostics);
+		}
+
+		if (std::find(args.begin(), args.end(), "-fno-const-fold") == args.end())
+		{
+			ConstantFolder folder;
+			for (auto& function : module.functions)
+				folder.run(function);
+		}
+
+		Chip8::Code code;
+		if (std::find(args.begin(), args.end(), "-fno-dce") == args.end())
+		{
+			bool stats = std::find(args.begin(), args.end(), "-fdce-stats") != args.end();
+
+			// Code of the whole module is generated once more to measure
+			// the difference
+			IR::Module whole;
+			if (stats) whole = module;
+
+			DeadCodeEliminator eliminator;
+			eliminator.run(module);
+
+			code = generate(module, &diagnostics);
+
+			if (stats)
+				eliminator.printStats(diagnostics, RomSize(generate(whole, nullptr)) - RomSize(code));
+		}
+		else
+		{
+			code = generate(module, &diagnostics);
+		}
+
+		// The assembly is written as a listing on request, a ROM otherwise
+		if (std::find(args.begin(), args.end(), "-S") != args.end())
+		{
+			output = code.toAssembly();
+			return;
+		}
+
+		Chip8Assembler assembler;
+		if (!assembler.assemble(code))
+		{
+			ReportsManager::ReportError(tree.name.pos, "can't assemble the program: " + assembler.getError());
+			return;
+		}
+
+		output = assembler.getRom();
+	}
+
+	Chip8::Code Driver::generate(IR::Module& module, std::ostream* diagnostics) const
+	{
+		bool allocate = std::find(args.begin(), args.end(), "-fno-regalloc") == args.end();
+
+		RegisterAllocator allocator;
+		std::vector<Allocation> allocations;
+		for (auto& function : module.functions)
+			allocations.push_back(allocate ? allocator.allocate(function) : RegisterAllocator::SpillAll(function));
+
+		if (diagnostics != nullptr && std::find(args.begin(), args.end(), "-fdump-ir") != args.end())
+			IR::Print(*diagnostics, module);
+
+		bool checkStack = std::find(args.begin(), args.end(), "-fstack-check") != args.end();
+
+		Chip8Emitter emitter(module, allocations, checkStack);
+		Chip8::Code code = emitter.emit();
+
+		if (std::find(args.begin(), args.end(), "-fno-peephole") == args.end())
+		{
+			std::vector<std::string> functions;
+			for (auto const& function : module.functions)
+				functions.push_back(function.name);
+
+			PeepholeOptimizer peephole(functions);
+			peephole.run(code);
+
+			if (diagnostics != nullptr && std::find(args.begin(), args.end(), "-fpeephole-stats") != args.end())
+				peephole.printStats(*diagnostics);
+		}
+
+		return code;
+	}
+
+	std::string const& Driver::getOutput() const
+	{
+		return output;
+	}
+
+	std::string Driver::GetInputFileName(std::vector<std::string> const& args)
+	{
+		for (auto it = args.begin(); it != args.end(); ++it)
+		{
+			if (takesValue(*it))
+			{
+				if (++it == args.end()) break;
+			}
+			else if (it->rfind("-", 0) != 0)
+			{
+				return *it;
+			}
+		}
+
+		return "";
+	}
+
+	std::vector<std::string> Driver::GetInputFileNames(std::vector<std::string> const& args)
+	{
+		std::vector<std::string> res;
+		for (auto it = args.begin(); it != args.end(); ++it)
+		{
+			if (takesValue(*it))
+			{
+				if (++it == args.end()) break;
+			}
+			else if (it->rfind("-", 0) != 0)
+			{
+				res.push_back(*it);
+			}
+		}
+
+		return res;
+	}
+
+	std::string Driver::GetOutputFileName(std::vector<std::string> const& args)
+	{
+		for (auto it = args.begin(); it != args.end(); ++it)
+		{
+			if (*it == "-o")
+			{
+				++it;
+				return it == args.end() ? "" : *it;
+			}
+		}
+
+		return "out" + GetOutputExtension(args);
+	}
+
+	std::string Driver::GetOutputExtension(std::vector<std::string> const& args)
+	{
+		return std::find(args.begin(), args.end(), "-S") != args.end() ? ".asm" : ".ch8";
+	}
+} // namespace Pascal
@@ -0,0 +1,108 @@
+#include <FrameLayout.hpp>
+#include <AST.hpp>
+
+namespace Pascal
+{
+	namespace
+	{
+		template <typename Decls>
+		void addAll(FrameLayout& layout, Decls const& decls)
+		{
+			// Constants with a known value are folded, they have no storage
+			for (auto const& decl : decls)
+				layout.add(decl->symbol.hasValue ? 0 : FrameLayout::SizeOf(decl->symbol.type));
+		}
+	}
+
+	FrameLayout::FrameLayout()
+		: m_Offsets(1, 0)
+	{ }
+
+	FrameLayout FrameLayout::OfProcedure(const AST::ProcDeclNode& node)
+	{
+		FrameLayout res;
+		addAll(res, node.params);
+		addAll(res, node.decls);
+		return res;
+	}
+
+	FrameLayout FrameLayout::OfProcedure(const AST::FunctionDeclNode& node)
+	{
+		FrameLayout res;
+		addAll(res, node.params);
+		addAll(res, node.decls);
+		return res;
+	}
+
+	FrameLayout FrameLayout::OfProgram(const AST::ProgramNode& node)
+	{
+		FrameLayout res;
+
+		for (auto const& decl : node.decls)
+		{
+			if (auto var = dynamic_cast<const AST::VarDeclNode*>(decl.get()))
+				res.add(var->symbol.hasValue ? 0 : SizeOf(var->symbol.type));
+			else
+				res.add(0);
+		}
+
+		return res;
+	}
+
+	unsigned FrameLayout::SizeOf(SymType type)
+	{
+		switch (type)
+		{
+		case SymType::INTEGER:
+			return 1;
+		case SymType::LONG:
+			return 2;
+		case SymType::PROCEDURE:
+			return 0;
+		}
+		return 0;
+	}
+
+	unsigned FrameLayout::add(unsigned size)
+	{
+		m_Offsets.push_back(m_Offsets.back() + size);
+		return count() - 1;
+	}
+
+	StackAddressing::StackAddressing(unsigned unit, unsigned base)
+		: unit(unit), base(base)
+	{ }
+
+	StackAddressing StackAddressing::ForZoneSize(unsigned bytes)
+	{
+		unsigned unit = 1;
+		while (unit * 256 < bytes)
+			unit *= 2;
+
+		return StackAddressing(unit);
+	}
+
+	void StackAddressing::loadAddress(Chip8::Code& code, unsigned baseReg, unsigned offset, unsigned scratchReg) const
+	{
+		code.addAddress(Chip8::Op::LD_I, "STACK_ZONE", base);
+
+		// There is no multiplication, the base is added `unit` times
+		for (unsigned i = 0; i < unit; i++)
+			code.add(Chip8::Op::ADD_I, baseReg);
+
+		AddToI(code, offset, scratchReg);
+	}
+
+	void StackAddressing::AddToI(Chip8::Code& code, unsigned offset, unsigned scratchReg)
+	{
+		while (offset > 0)
+		{
+			unsigned step = offset > 0xFF ? 0xFF : offset;
+
+			code.add(Chip8::Op::LD_IMM, scratchReg, 0, step);
+			code.add(Chip8::Op::ADD_I, scratchReg);
+
+			offset -= step;
+		}
+	}
+} // namespace Pascal
@@ -0,0 +1,207 @@
+#include <IR.hpp>
+#include <Intrinsics.hpp>
+
+#include <algorithm>
+
+namespace Pascal
+{
+	namespace IR
+	{
+		namespace
+		{
+			const char* opcodeName(Opcode op)
+			{
+				switch (op)
+				{
+				case Opcode::CONST: return "const";
+				case Opcode::COPY: return "copy";
+				case Opcode::ADD: return "add";
+				case Opcode::SUB: return "sub";
+				case Opcode::NEG: return "neg";
+				case Opcode::EXTEND: return "extend";
+				case Opcode::TRUNC: return "trunc";
+				case Opcode::LOAD: return "load";
+				case Opcode::STORE: return "store";
+				case Opcode::ARG: return "arg";
+				case Opcode::CALL: return "call";
+				case Opcode::INTRINSIC: return "intrinsic";
+				case Opcode::JUMP: return "jump";
+				case Opcode::BRANCH: return "branch";
+				case Opcode::RET: return "ret";
+				}
+				return "?";
+			}
+
+			const char* widthName(Width width)
+			{
+				return width == Width::WORD ? "w" : "b";
+			}
+
+			void printVar(std::ostream& out, Module const& module, Var var)
+			{
+				switch (var.storage)
+				{
+				case StorageClass::GLOBAL:
+					out << "@" << module.globalNames[var.slot];
+					break;
+				case StorageClass::PARAM:
+				case StorageClass::LOCAL:
+					out << "frame[" << var.slot << "]";
+					break;
+				default:
+					out << "?";
+					break;
+				}
+			}
+		}
+
+		Width WidthOf(SymType type)
+		{
+			return type == SymType::LONG ? Width::WORD : Width::BYTE;
+		}
+
+		bool IsTerminator(Opcode op)
+		{
+			return op == Opcode::JUMP || op == Opcode::BRANCH || op == Opcode::RET;
+		}
+
+		bool IsPure(Opcode op)
+		{
+			switch (op)
+			{
+			case Opcode::CONST:
+			case Opcode::COPY:
+			case Opcode::ADD:
+			case Opcode::SUB:
+			case Opcode::NEG:
+			case Opcode::EXTEND:
+			case Opcode::TRUNC:
+			case Opcode::LOAD:
+				return true;
+
+			default:
+				return false;
+			}
+		}
+
+		VReg Function::newVReg(Width width)
+		{
+			vregs.push_back(width);
+			return static_cast<VReg>(vregs.size() - 1);
+		}
+
+		void RemoveDeadValues(Function& function)
+		{
+			std::vector<unsigned> uses(function.vregs.size(), 0);
+			for (auto const& block : function.blocks)
+			{
+				for (auto const& instr : block.instrs)
+				{
+					if (instr.a != NoReg) uses[instr.a]++;
+					if (instr.b != NoReg) uses[instr.b]++;
+				}
+			}
+
+			// Readers follow writers in a block, walking backwards drops
+			// whole unused expressions at once
+			for (auto& block : function.blocks)
+			{
+				std::vector<Instr> kept;
+				kept.reserve(block.instrs.size());
+
+				for (auto it = block.instrs.rbegin(); it != block.instrs.rend(); ++it)
+				{
+					if (IsPure(it->op) && uses[it->dst] == 0)
+					{
+						if (it->a != NoReg) uses[it->a]--;
+						if (it->b != NoReg) uses[it->b]--;
+						continue;
+					}
+
+					kept.push_back(*it);
+				}
+
+				std::reverse(kept.begin(), kept.end());
+				block.instrs = std::move(kept);
+			}
+		}
+
+		void Print(std::ostream& out, Module const& module)
+		{
+			out << "module " << module.name << std::endl;
+
+			for (unsigned slot = 0; slot < module.globals.count(); slot++)
+			{
+				if (module.globals.sizeOf(slot) == 0) continue;
+				out << "global @" << module.globalNames[slot] << " : " << module.globals.sizeOf(slot) << std::endl;
+			}
+
+			for (auto const& function : module.functions)
+			{
+				out << std::endl << "function " << function.name << "(";
+				if (function.signature != nullptr)
+				{
+					for (unsigned i = 0; i < function.signature->arity(); i++)
+					{
+						if (i != 0) out << ", ";
+						out << widthName(WidthOf(function.signature->params[i]));
+					}
+				}
+				out << ") frame " << function.frame.size() << ", " << function.vregs.size() << " vregs" << std::endl;
+
+				for (unsigned b = 0; b < function.blocks.size(); b++)
+				{
+					out << "bb" << b << ":" << std::endl;
+
+					for (auto const& instr : function.blocks[b].instrs)
+					{
+						out << "    ";
+						if (instr.dst != NoReg)
+							out << "%" << instr.dst << ":" << widthName(instr.width) << " = ";
+
+						out << opcodeName(instr.op);
+
+						switch (instr.op)
+						{
+						case Opcode::CONST:
+							out << " " << instr.imm;
+							break;
+						case Opcode::LOAD:
+							out << " ";
+							printVar(out, module, instr.var);
+							break;
+						case Opcode::STORE:
+							out << "." << widthName(instr.width) << " ";
+							printVar(out, module, instr.var);
+							out << ", %" << instr.a;
+							break;
+						case Opcode::ARG:
+							out << "." << widthName(instr.width) << " " << instr.index << ", %" << instr.a;
+							break;
+						case Opcode::CALL:
+							out << " " << module.functions[instr.target].name;
+							break;
+						case Opcode::INTRINSIC:
+							out << " " << Intrinsics[instr.target].name;
+							break;
+						case Opcode::JUMP:
+							out << " bb" << instr.target;
+							break;
+						case Opcode::BRANCH:
+							out << " %" << instr.a << ", bb" << instr.target << ", bb" << instr.elseTarget;
+							break;
+						case Opcode::RET:
+							break;
+						default:
+							out << " %" << instr.a;
+							if (instr.b != NoReg) out << ", %" << instr.b;
+							break;
+						}
+
+						out << std::endl;
+					}
+				}
+			}
+		}
+	} // namespace IR
+} // namespace Pascal
@@ -0,0 +1,424 @@
+#include <IRBuilder.hpp>
+
+#include <AST.hpp>
+#include <ReportsManager.hpp>
+#include <Intrinsics.hpp>
+
+#include <algorithm>
+
+namespace Pascal
+{
+	using IR::Opcode;
+	using IR::Width;
+	using IR::VReg;
+
+	IRBuilder::IRBuilder()
+		: function(nullptr), block(0), width(Width::BYTE), registerCount(this), operandOrder(this),
+		  counter(nullptr, &registerCount), walker(&operandOrder, this)
+	{ }
+
+	IRBuilder::~IRBuilder()
+	{
+
+	}
+
+	IR::Module IRBuilder::build(const AST::ProgramNode& tree)
+	{
+		module = IR::Module();
+		functionOfSlot.clear();
+		values.clear();
+		needs.clear();
+		steps.clear();
+		tree.accept(this);
+		return std::move(module);
+	}
+
+	void IRBuilder::visitProgramNode(const AST::ProgramNode& node)
+	{
+		module.name = node.name.str;
+		module.globals = FrameLayout::OfProgram(node);
+
+		// Main program first, procedures in the order of declaration. All
+		// indices are known before any call is lowered.
+		module.functions.emplace_back();
+		module.functions[0].name = "__start__main";
+		module.functions[0].pos = node.name.pos;
+
+		for (auto const& decl : node.decls)
+		{
+			if (auto var = dynamic_cast<const AST::VarDeclNode*>(decl.get()))
+			{
+				module.globalNames.push_back(var->name.str);
+				functionOfSlot.push_back(-1);
+			}
+			else if (auto proc = dynamic_cast<const AST::ProcDeclNode*>(decl.get()))
+			{
+				module.globalNames.push_back(proc->name.str);
+				functionOfSlot.push_back(static_cast<int>(module.functions.size()));
+
+				module.functions.emplace_back();
+				module.functions.back().name = proc->name.str;
+				module.functions.back().pos = proc->name.pos;
+				module.functions.back().signature = proc->symbol.signature;
+				module.functions.back().frame = FrameLayout::OfProcedure(*proc);
+			}
+			else if (auto func = dynamic_cast<const AST::FunctionDeclNode*>(decl.get()))
+			{
+				module.globalNames.push_back(func->name.str);
+				functionOfSlot.push_back(-1);
+			}
+		}
+
+		for (auto const& decl : node.decls)
+			decl->accept(this);
+
+		function = &module.functions[0];
+		block = newBlock();
+
+		lowerStatement(*node.compound);
+		emit(Opcode::RET, Width::BYTE);
+	}
+
+	void IRBuilder::visitCompoundNode(const AST::CompoundNode& node)
+	{
+		for (auto it = node.stmts.rbegin(); it != node.stmts.rend(); ++it)
+			steps.push_back({ it->get(), nullptr, false, {}, {}, 0, 0 });
+	}
+
+	void IRBuilder::visitVarDeclNode(const AST::VarDeclNode&)
+	{
+		// Storage is placed by FrameLayout
+	}
+
+	void IRBuilder::visitTypeNode(const AST::TypeNode&)
+	{
+
+	}
+
+	void IRBuilder::visitProcDeclNode(const AST::ProcDeclNode& node)
+	{
+		function = &module.functions[functionOfSlot[node.symbol.slot]];
+		block = newBlock();
+
+		lowerStatement(*node.compound);
+		emit(Opcode::RET, Width::BYTE);
+	}
+
+	void IRBuilder::visitAssignmentNode(const AST::AssignmentNode& node)
+	{
+		Width target = IR::WidthOf(node.var->symbol.type);
+		VReg value = lower(*node.expr, target);
+
+		IR::Instr& store = emit(Opcode::STORE, target);
+		store.a = value;
+		store.var = varOf(node.var->symbol);
+	}
+
+	void IRBuilder::visitVarNode(const AST::VarNode& node)
+	{
+		if (node.symbol.hasValue)
+		{
+			// Constants are zero-extended or truncated like variables
+			IR::Instr& instr = emit(Opcode::CONST, width);
+			instr.dst = function->newVReg(width);
+			instr.imm = static_cast<uint16_t>(width == Width::BYTE ? node.symbol.value & 0xFF : node.symbol.value);
+
+			values.push_back(instr.dst);
+			return;
+		}
+
+		Width own = IR::WidthOf(node.symbol.type);
+
+		IR::Instr& load = emit(Opcode::LOAD, own);
+		load.dst = function->newVReg(own);
+		load.var = varOf(node.symbol);
+
+		values.push_back(convert(load.dst, width));
+	}
+
+	void IRBuilder::visitIntLiteralNode(const AST::IntLiteralNode& node)
+	{
+		unsigned long literal = 0;
+
+		try
+		{
+			literal = std::stoul(node.token.str);
+		}
+		catch (...)
+		{
+			literal = 0x10000;
+		}
+
+		if (literal > 0xFFFF)
+		{
+			ReportsManager::ReportError(node.token.pos, ErrorType::CANT_PARSE_LITERAL);
+			literal = 0;
+		}
+
+		IR::Instr& instr = emit(Opcode::CONST, width);
+		instr.dst = function->newVReg(width);
+		instr.imm = static_cast<uint16_t>(width == Width::BYTE ? literal & 0xFF : literal);
+
+		values.push_back(instr.dst);
+	}
+
+	void IRBuilder::visitBinaryExprNode(const AST::BinaryExprNode& node)
+	{
+		Opcode op = Opcode::ADD;
+
+		switch (node.op.type)
+		{
+		case TokenType::PLUS:
+			op = Opcode::ADD;
+			break;
+		case TokenType::MINUS:
+			op = Opcode::SUB;
+			break;
+
+		default:
+			ReportsManager::ReportError(node.op.pos, "Operation unimplemented");
+			break;
+		}
+
+		// Sethi-Ullman order: the operand needing more registers goes
+		// first, so the value of the other one isn't held meanwhile.
+		// Operands have no side effects, only the order of the code
+		// changes. OperandOrder has the walker visit them in this order.
+		VReg second = values.back();
+		values.pop_back();
+		VReg first = values.back();
+		values.pop_back();
+
+		if (rightFirst(node))
+			values.push_back(emitValue(op, width, second, first));
+		else
+			values.push_back(emitValue(op, width, first, second));
+	}
+
+	void IRBuilder::visitUnaryExprNode(const AST::UnaryExprNode& node)
+	{
+		if (node.op.type == TokenType::MINUS)
+			values.back() = emitValue(Opcode::NEG, width, values.back());
+	}
+
+	void IRBuilder::visitProcCallNode(const AST::CallStmtNode& node)
+	{
+		bool isBuiltin = node.symbol.storage == StorageClass::BUILTIN;
+
+		// All arguments are evaluated before any is passed
+		std::vector<VReg> args;
+		std::vector<Width> widths;
+		for (unsigned i = 0; i < node.args.size(); i++)
+		{
+			SymType type = isBuiltin ? Intrinsics[node.symbol.slot].params[i] : node.symbol.signature->params[i];
+
+			widths.push_back(IR::WidthOf(type));
+			args.push_back(lower(*node.args[i], widths.back()));
+		}
+
+		for (unsigned i = 0; i < args.size(); i++)
+		{
+			IR::Instr& arg = emit(Opcode::ARG, widths[i]);
+			arg.a = args[i];
+			arg.index = i;
+		}
+
+		if (isBuiltin)
+		{
+			emit(Opcode::INTRINSIC, Width::BYTE).target = node.symbol.slot;
+		}
+		else
+		{
+			emit(Opcode::CALL, Width::BYTE).target = static_cast<unsigned>(functionOfSlot[node.symbol.slot]);
+		}
+	}
+
+	void IRBuilder::visitFunctionDeclNode(const AST::FunctionDeclNode&)
+	{
+		// The parser doesn't produce functions yet, they have no code
+	}
+
+	void IRBuilder::visitIfNode(const AST::IfNode& node)
+	{
+		VReg condition = lower(*node.condition, Width::WORD);
+		emit(Opcode::BRANCH, Width::WORD).a = condition;
+
+		// Blocks are numbered in the order of the source, targets are set
+		// when they are known
+		Step end = { nullptr, &node, false, lastJump(), {}, newBlock(), 0 };
+		block = end.thenBlock;
+
+		steps.push_back(end);
+		steps.push_back({ node.thenArm.get(), nullptr, false, {}, {}, 0, 0 });
+	}
+
+	void IRBuilder::lowerStatement(const AST::StmtNode& stmt)
+	{
+		steps.push_back({ &stmt, nullptr, false, {}, {}, 0, 0 });
+
+		while (!steps.empty())
+		{
+			Step step = steps.back();
+			steps.pop_back();
+
+			if (step.stmt != nullptr)
+				step.stmt->accept(this);
+			else
+				endArm(step);
+		}
+	}
+
+	void IRBuilder::endArm(Step step)
+	{
+		AST::IfNode const& node = *step.ifNode;
+
+		emit(Opcode::JUMP, Width::BYTE);
+		Jump armEnd = lastJump();
+
+		if (!step.elseArm)
+		{
+			step.thenEnd = armEnd;
+
+			if (node.elseArm != nullptr)
+			{
+				step.elseArm = true;
+				step.elseBlock = newBlock();
+				block = step.elseBlock;
+
+				steps.push_back(step);
+				steps.push_back({ node.elseArm.get(), nullptr, false, {}, {}, 0, 0 });
+				return;
+			}
+		}
+
+		unsigned joinBlock = newBlock();
+		block = joinBlock;
+
+		jumpAt(step.branch).target = step.thenBlock;
+		jumpAt(step.branch).elseTarget = node.elseArm != nullptr ? step.elseBlock : joinBlock;
+		jumpAt(step.thenEnd).target = joinBlock;
+		jumpAt(armEnd).target = joinBlock;
+	}
+
+	void IRBuilder::visitFunctionCall(const AST::FunctionCallNode&)
+	{
+		// See visitFunctionDeclNode
+		values.push_back(emitValue(Opcode::CONST, width));
+	}
+
+	VReg IRBuilder::lower(const AST::ExpressionNode& expr, Width width)
+	{
+		this->width = width;
+
+		needs.clear();
+		counter.walk(expr);
+		walker.walk(expr);
+
+		VReg value = values.back();
+		values.pop_back();
+		return value;
+	}
+
+	bool IRBuilder::rightFirst(const AST::BinaryExprNode& node) const
+	{
+		return needs.at(node.right.get()) > needs.at(node.left.get());
+	}
+
+	VReg IRBuilder::convert(VReg value, Width to)
+	{
+		Width from = function->vregs[value];
+		if (from == to) return value;
+
+		return emitValue(to == Width::WORD ? Opcode::EXTEND : Opcode::TRUNC, to, value);
+	}
+
+	IR::Instr& IRBuilder::emit(Opcode op, Width width)
+	{
+		IR::Instr instr;
+		instr.op = op;
+		instr.width = width;
+
+		auto& instrs = function->blocks[block].instrs;
+		instrs.push_back(instr);
+		return instrs.back();
+	}
+
+	VReg IRBuilder::emitValue(Opcode op, Width width, VReg a, VReg b)
+	{
+		IR::Instr& instr = emit(op, width);
+		instr.dst = function->newVReg(width);
+		instr.a = a;
+		instr.b = b;
+		return instr.dst;
+	}
+
+	IRBuilder::Jump IRBuilder::lastJump() const
+	{
+		return { block, function->blocks[block].instrs.size() - 1 };
+	}
+
+	IR::Instr& IRBuilder::jumpAt(Jump jump)
+	{
+		return function->blocks[jump.block].instrs[jump.instr];
+	}
+
+	unsigned IRBuilder::newBlock()
+	{
+		function->blocks.emplace_back();
+		return static_cast<unsigned>(function->blocks.size() - 1);
+	}
+
+	IR::Var IRBuilder::varOf(SymbolRef const& symbol)
+	{
+		IR::Var var;
+		var.storage = symbol.storage;
+		var.slot = symbol.slot;
+		return var;
+	}
+
+	IRBuilder::RegisterCount::RegisterCount(IRBuilder* owner)
+		: owner(owner)
+	{ }
+
+	// A value takes a register per byte
+	void IRBuilder::RegisterCount::visitVarNode(const AST::VarNode& node)
+	{
+		owner->needs[&node] = static_cast<unsigned>(owner->width);
+	}
+
+	void IRBuilder::RegisterCount::visitIntLiteralNode(const AST::IntLiteralNode& node)
+	{
+		owner->needs[&node] = static_cast<unsigned>(owner->width);
+	}
+
+	void IRBuilder::RegisterCount::visitBinaryExprNode(const AST::BinaryExprNode& node)
+	{
+		unsigned size = static_cast<unsigned>(owner->width);
+		unsigned left = owner->needs.at(node.left.get());
+		unsigned right = owner->needs.at(node.right.get());
+
+		// The operand evaluated first is held while the other one is
+		owner->needs[&node] = std::min(std::max(left, size + right), std::max(right, size + left));
+	}
+
+	void IRBuilder::RegisterCount::visitUnaryExprNode(const AST::UnaryExprNode& node)
+	{
+		owner->needs[&node] = owner->needs.at(node.expr.get());
+	}
+
+	void IRBuilder::RegisterCount::visitFunctionCall(const AST::FunctionCallNode& node)
+	{
+		owner->needs[&node] = static_cast<unsigned>(owner->width);
+	}
+
+	IRBuilder::OperandOrder::OperandOrder(IRBuilder* owner)
+		: owner(owner)
+	{ }
+
+	void IRBuilder::OperandOrder::visitBinaryExprNode(const AST::BinaryExprNode& node)
+	{
+		// Operands are counted before the expression is walked
+		if (owner->rightFirst(node))
+			owner->walker.reverseChildren();
+	}
+} // namespace Pascal
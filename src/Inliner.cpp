@@ -0,0 +1,398 @@
+#include <Inliner.hpp>
+#include <Chip8Assembler.hpp>
+#include <Intrinsics.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+namespace Pascal
+{
+	using IR::Opcode;
+	using IR::VReg;
+
+	namespace
+	{
+		// Instructions of the code Chip8Emitter writes, with the stack
+		// addressed in units of one byte
+
+		// Moves, the address of the slot past sp and the store
+		const unsigned ArgCost = 5;
+		// Address of the slot and the load, done on entry
+		const unsigned ParamLoadCost = 4;
+		// Prologue and epilogue saving registers, ret
+		const unsigned FrameCost = 24;
+
+		// SPEED inlines bodies up to this many times the call overhead
+		const unsigned SpeedRatio = 2;
+		// Part of the memory, in percents, SPEED lets the program grow to
+		const unsigned BudgetPercent = 75;
+
+		unsigned arityOf(IR::Function const& function)
+		{
+			return function.signature != nullptr ? function.signature->arity() : 0;
+		}
+
+		// Instructions of a call at the call site
+		unsigned siteCost(IR::Function const& callee)
+		{
+			return 1 + ArgCost * arityOf(callee);
+		}
+
+		// Instructions of a procedure besides its body
+		unsigned outOfLineCost(IR::Function const& callee)
+		{
+			return FrameCost + ParamLoadCost * arityOf(callee);
+		}
+
+		// Cycles a call takes besides the body
+		unsigned callOverhead(IR::Function const& callee)
+		{
+			return siteCost(callee) + outOfLineCost(callee);
+		}
+
+		unsigned instrCost(IR::Instr const& instr)
+		{
+			bool word = instr.width == IR::Width::WORD;
+
+			switch (instr.op)
+			{
+			case Opcode::CONST:
+			case Opcode::COPY:
+			case Opcode::TRUNC:
+				return word ? 2 : 1;
+			case Opcode::EXTEND:
+				return 2;
+			case Opcode::ADD:
+			case Opcode::SUB:
+				return word ? 6 : 2;
+			case Opcode::NEG:
+				return word ? 7 : 3;
+			// Locals are kept in registers mostly
+			case Opcode::LOAD:
+			case Opcode::STORE:
+				return instr.var.isGlobal() ? 2 : 1;
+			case Opcode::ARG:
+				return ArgCost;
+			case Opcode::CALL:
+				return 1;
+			case Opcode::INTRINSIC:
+				return Intrinsics[instr.target].cycles;
+			case Opcode::JUMP:
+				return 1;
+			case Opcode::BRANCH:
+				return word ? 4 : 3;
+			case Opcode::RET:
+				return 0;
+			}
+			return 0;
+		}
+	}
+
+	Inliner::Inliner(Goal goal)
+		: goal(goal), moduleCost(0), inlined(0), cyclesSaved(0), romGrowth(0)
+	{ }
+
+	unsigned Inliner::BodyCost(IR::Function const& function)
+	{
+		unsigned res = 0;
+		for (auto const& block : function.blocks)
+			for (auto const& instr : block.instrs)
+				res += instrCost(instr);
+
+		return res;
+	}
+
+	void Inliner::run(IR::Module& module)
+	{
+		size_t count = module.functions.size();
+
+		costs.assign(count, 0);
+		callSites.assign(count, 0);
+		moduleCost = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			IR::Function const& function = module.functions[i];
+
+			costs[i] = BodyCost(function);
+			moduleCost += costs[i] + (function.isMain() ? 0 : outOfLineCost(function));
+
+			for (auto const& block : function.blocks)
+				for (auto const& instr : block.instrs)
+					if (instr.op == Opcode::CALL) callSites[instr.target]++;
+		}
+
+		// Callees are complete before they are copied into their callers
+		for (unsigned function : bottomUpOrder(module))
+		{
+			inlineCalls(module, function);
+			costs[function] = BodyCost(module.functions[function]);
+		}
+	}
+
+	void Inliner::printStats(std::ostream& out) const
+	{
+		out << "Inlining: " << inlined << " calls inlined, " << cyclesSaved
+			<< " cycles of call overhead saved if each runs once, ROM estimated to "
+			<< (romGrowth > 0 ? "grow" : "shrink") << " by " << std::abs(romGrowth) * 2 << " bytes." << std::endl;
+	}
+
+	std::vector<unsigned> Inliner::bottomUpOrder(IR::Module const& module)
+	{
+		size_t count = module.functions.size();
+
+		// Distinct callers of every function, and callees not placed yet
+		std::vector<std::vector<unsigned>> callers(count);
+		std::vector<unsigned> pending(count, 0);
+
+		for (unsigned f = 0; f < count; f++)
+		{
+			std::vector<unsigned> callees;
+			for (auto const& block : module.functions[f].blocks)
+				for (auto const& instr : block.instrs)
+					if (instr.op == Opcode::CALL) callees.push_back(instr.target);
+
+			std::sort(callees.begin(), callees.end());
+			callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+
+			for (unsigned callee : callees)
+				callers[callee].push_back(f);
+			pending[f] = static_cast<unsigned>(callees.size());
+		}
+
+		std::vector<unsigned> ready;
+		for (unsigned f = 0; f < count; f++)
+		{
+			if (pending[f] == 0) ready.push_back(f);
+		}
+
+		inlinable.assign(count, false);
+		std::vector<unsigned> order;
+
+		while (!ready.empty())
+		{
+			unsigned f = ready.back();
+			ready.pop_back();
+
+			order.push_back(f);
+			inlinable[f] = !module.functions[f].isMain();
+
+			for (unsigned caller : callers[f])
+				if (--pending[caller] == 0) ready.push_back(caller);
+		}
+
+		// A cycle of calls never gets ready, the functions in it and their
+		// callers may still have their other calls inlined
+		for (unsigned f = 0; f < count; f++)
+		{
+			if (pending[f] != 0) order.push_back(f);
+		}
+
+		return order;
+	}
+
+	int Inliner::growthOf(IR::Module const& module, unsigned callee) const
+	{
+		IR::Function const& function = module.functions[callee];
+		int growth = static_cast<int>(costs[callee]) - static_cast<int>(siteCost(function));
+
+		// The last call takes the procedure away
+		if (callSites[callee] == 1)
+			growth -= static_cast<int>(costs[callee] + outOfLineCost(function));
+
+		return growth;
+	}
+
+	bool Inliner::shouldInline(IR::Module const& module, unsigned callee) const
+	{
+		if (!inlinable[callee])
+			return false;
+
+		int growth = growthOf(module, callee);
+		if (growth <= 0)
+			return true;
+
+		if (goal == Goal::SIZE)
+			return false;
+
+		const int Budget = (Chip8Assembler::MemorySize - Chip8Assembler::LoadAddress) / 2 * BudgetPercent / 100;
+
+		return costs[callee] <= SpeedRatio * callOverhead(module.functions[callee]) &&
+			static_cast<int>(moduleCost) + growth <= Budget;
+	}
+
+	void Inliner::inlineCalls(IR::Module& module, unsigned caller)
+	{
+		IR::Function& function = module.functions[caller];
+
+		std::vector<IR::BasicBlock> old = std::move(function.blocks);
+		std::vector<IR::BasicBlock> blocks;
+
+		// First block every old one begins, blocks ending with an old
+		// terminator whose targets are renumbered at the end
+		std::vector<unsigned> first(old.size(), 0);
+		std::vector<unsigned> renumbered;
+
+		// First frame slot of every procedure inlined here
+		std::map<unsigned, unsigned> slotBases;
+
+		for (size_t b = 0; b < old.size(); b++)
+		{
+			first[b] = static_cast<unsigned>(blocks.size());
+			blocks.emplace_back();
+
+			// ARG instructions of the next call, in the last block
+			std::vector<size_t> pendingArgs;
+
+			for (auto const& instr : old[b].instrs)
+			{
+				if (instr.op == Opcode::ARG)
+					pendingArgs.push_back(blocks.back().instrs.size());
+
+				if (instr.op != Opcode::CALL || !shouldInline(module, instr.target))
+				{
+					if (instr.op == Opcode::CALL || instr.op == Opcode::INTRINSIC)
+						pendingArgs.clear();
+
+					blocks.back().instrs.push_back(instr);
+					continue;
+				}
+
+				IR::Function const& callee = module.functions[instr.target];
+				unsigned params = arityOf(callee);
+
+				int growth = growthOf(module, instr.target);
+				moduleCost = static_cast<unsigned>(static_cast<int>(moduleCost) + growth);
+				romGrowth += growth;
+				cyclesSaved += callOverhead(callee);
+				inlined++;
+				callSites[instr.target]--;
+
+				// Parameters the callee assigns need their slots
+				std::vector<bool> assigned(params, false);
+				for (auto const& block : callee.blocks)
+					for (auto const& calleeInstr : block.instrs)
+						if (calleeInstr.op == Opcode::STORE && !calleeInstr.var.isGlobal() && calleeInstr.var.slot < params)
+							assigned[calleeInstr.var.slot] = true;
+
+				auto base = slotBases.find(instr.target);
+				if (base == slotBases.end())
+				{
+					base = slotBases.emplace(instr.target, function.frame.count()).first;
+
+					for (unsigned slot = 0; slot < callee.frame.count(); slot++)
+						function.frame.add(slot < params && !assigned[slot] ? 0 : callee.frame.sizeOf(slot));
+				}
+				unsigned slotBase = base->second;
+
+				// Arguments are stored to the slots or read in place
+				std::vector<VReg> args(params, IR::NoReg);
+				std::vector<IR::Instr>& current = blocks.back().instrs;
+				std::vector<IR::Instr> stores;
+
+				for (size_t position : pendingArgs)
+				{
+					IR::Instr const& arg = current[position];
+					args[arg.index] = arg.a;
+
+					if (!assigned[arg.index]) continue;
+
+					IR::Instr store;
+					store.op = Opcode::STORE;
+					store.width = arg.width;
+					store.a = arg.a;
+					store.var.storage = StorageClass::LOCAL;
+					store.var.slot = slotBase + arg.index;
+					stores.push_back(store);
+				}
+
+				for (size_t i = pendingArgs.size(); i-- > 0;)
+					current.erase(current.begin() + static_cast<std::ptrdiff_t>(pendingArgs[i]));
+				pendingArgs.clear();
+
+				current.insert(current.end(), stores.begin(), stores.end());
+
+				// The body follows, then the rest of the old block
+				unsigned entry = static_cast<unsigned>(blocks.size());
+				unsigned next = entry + static_cast<unsigned>(callee.blocks.size());
+
+				IR::Instr jump;
+				jump.op = Opcode::JUMP;
+				jump.target = entry;
+				current.push_back(jump);
+
+				VReg vregBase = static_cast<VReg>(function.vregs.size());
+				function.vregs.insert(function.vregs.end(), callee.vregs.begin(), callee.vregs.end());
+
+				for (auto const& block : callee.blocks)
+				{
+					blocks.emplace_back();
+					blocks.back().instrs.reserve(block.instrs.size());
+
+					for (IR::Instr copy : block.instrs)
+					{
+						if (copy.dst != IR::NoReg) copy.dst += vregBase;
+						if (copy.a != IR::NoReg) copy.a += vregBase;
+						if (copy.b != IR::NoReg) copy.b += vregBase;
+
+						switch (copy.op)
+						{
+						case Opcode::LOAD:
+						case Opcode::STORE:
+							if (copy.var.isGlobal()) break;
+
+							if (copy.op == Opcode::LOAD && copy.var.slot < params && !assigned[copy.var.slot])
+							{
+								copy.op = Opcode::COPY;
+								copy.a = args[copy.var.slot];
+								copy.var = IR::Var();
+								break;
+							}
+
+							copy.var.storage = StorageClass::LOCAL;
+							copy.var.slot += slotBase;
+							break;
+
+						case Opcode::CALL:
+							callSites[copy.target]++;
+							break;
+
+						case Opcode::JUMP:
+						case Opcode::BRANCH:
+							copy.target += entry;
+							copy.elseTarget += entry;
+							break;
+
+						case Opcode::RET:
+							copy.op = Opcode::JUMP;
+							copy.target = next;
+							break;
+
+						default:
+							break;
+						}
+
+						blocks.back().instrs.push_back(copy);
+					}
+				}
+
+				blocks.emplace_back();
+			}
+
+			renumbered.push_back(static_cast<unsigned>(blocks.size() - 1));
+		}
+
+		for (unsigned b : renumbered)
+		{
+			IR::Instr& last = blocks[b].instrs.back();
+			if (last.op == Opcode::JUMP || last.op == Opcode::BRANCH)
+			{
+				last.target = first[last.target];
+				last.elseTarget = first[last.elseTarget];
+			}
+		}
+
+		function.blocks = std::move(blocks);
+	}
+} // namespace Pascal
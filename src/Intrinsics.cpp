@@ -0,0 +1,62 @@
+#include <Intrinsics.hpp>
+
+namespace Pascal
+{
+	using Chip8::Op;
+
+	namespace
+	{
+		// Prints three BCD digits stored at `zone`, vC is restored to 0xFF
+		void printBcd(Chip8::Code& code, const char* zone)
+		{
+			code.add(Op::LD_IMM, 0xC, 0, 0);
+			code.addAddress(Op::LD_I, zone);
+			code.add(Op::LOAD, 2);
+
+			code.add(Op::LD_F, 0);
+			code.add(Op::DRW, 0xC, 0xC, 5);
+			code.add(Op::LD_IMM, 0, 0, 6);
+
+			code.add(Op::LD_F, 1);
+			code.add(Op::DRW, 0, 0xC, 5);
+
+			code.add(Op::ADD_IMM, 0, 0, 6);
+
+			code.add(Op::LD_F, 2);
+			code.add(Op::DRW, 0, 0xC, 5);
+
+			code.add(Op::LD_IMM, 0xC, 0, 0xFF);
+		}
+	}
+
+	namespace IntrinsicCode
+	{
+		void cls(Chip8::Code& code)
+		{
+			code.add(Op::CLS);
+		}
+
+		void makeBcd(Chip8::Code& code)
+		{
+			code.addAddress(Op::LD_I, "BCD_ZONE_LOW");
+			code.add(Op::LD_B, 2);
+			code.addAddress(Op::LD_I, "BCD_ZONE_HIGH");
+			code.add(Op::LD_B, 3);
+		}
+
+		void debugPrintBcd(Chip8::Code& code)
+		{
+			printBcd(code, "BCD_ZONE_LOW");
+		}
+
+		void debugPrintBcdHigh(Chip8::Code& code)
+		{
+			printBcd(code, "BCD_ZONE_HIGH");
+		}
+
+		void breakpoint(Chip8::Code& code)
+		{
+			code.add(Op::SYS);
+		}
+	}
+} // namespace Pascal
@@ -1,6 +1,7 @@
 #include <pscpch.hpp>
 #include <Parser.hpp>
 #include <ReportsManager.hpp>
+#include <TreeWalker.hpp>
 
 namespace Pascal
 {
@@ -35,6 +36,9 @@ namespace Pascal
 			
 			while (!matching(TokenType::BEGIN))
 			{
+				// synchronise() can't move past the end
+				if (isAtEnd()) throw ParserError("Expected 'begin' keyword");
+
 				try
 				{
 					decls.push_back(parseDeclaration());
@@ -76,18 +80,22 @@ namespace Pascal
 	{
 		Token t_Name;
 		std::unique_ptr<AST::TypeNode> t_Type;
+		std::unique_ptr<AST::ExpressionNode> t_Value;
 
 		bool isConst = previous().type == TokenType::CONST;
 
 		t_Name = require(TokenType::IDENTIFIER, "Expected variable name");
 		require(TokenType::COLON, "Expected ':' in variable declaration");
 		t_Type = parseType();
+		if (isConst && matching(TokenType::EQUAL))
+			t_Value = parseExpression();
 		require(TokenType::SEMICOLON, "Expected ';' after variable declaration");
 
 		return std::make_unique<AST::VarDeclNode>(
 			std::move(t_Name),
 			std::move(t_Type),
-			isConst
+			isConst,
+			std::move(t_Value)
 		);
 	}
 
@@ -153,59 +161,123 @@ namespace Pascal
 	
 	std::unique_ptr<AST::CompoundNode> Parser::parseCompound()
 	{
-		std::vector<std::unique_ptr<AST::StmtNode>> t_Stmts;
-		
-		while (!isAtEnd() && !check(TokenType::END))
+		// Innermost last. A statement that has been parsed completely is
+		// passed in `done` to the one it is a part of.
+		std::vector<OpenStmt> open(1);
+		open.back().kind = OpenStmt::COMPOUND;
+
+		std::unique_ptr<AST::StmtNode> done;
+
+		while (true)
 		{
 			try
 			{
-				t_Stmts.push_back(parseStmt());
+				OpenStmt& top = open.back();
+
+				if (done != nullptr)
+				{
+					if (top.kind == OpenStmt::COMPOUND)
+					{
+						top.stmts.push_back(std::move(done));
+					}
+					else if (top.kind == OpenStmt::THEN_ARM && matching(TokenType::ELSE))
+					{
+						top.thenArm = std::move(done);
+						top.kind = OpenStmt::ELSE_ARM;
+						continue;
+					}
+					else
+					{
+						std::unique_ptr<AST::StmtNode> thenArm = top.kind == OpenStmt::THEN_ARM ? std::move(done) : std::move(top.thenArm);
+						std::unique_ptr<AST::StmtNode> elseArm = top.kind == OpenStmt::ELSE_ARM ? std::move(done) : nullptr;
+
+						done = std::make_unique<AST::IfNode>(
+							std::move(top.condition),
+							std::move(thenArm),
+							std::move(elseArm)
+						);
+						open.pop_back();
+						continue;
+					}
+				}
+
+				if (top.kind == OpenStmt::COMPOUND && (isAtEnd() || check(TokenType::END)))
+				{
+					Token end = match(TokenType::END);
+					auto compound = std::make_unique<AST::CompoundNode>(
+						std::move(top.stmts)
+					);
+					open.pop_back();
+
+					// The enclosing compound statement recovers, the
+					// outermost one is left by the exception
+					if (end.type == TokenType::NONE)
+					{
+						releaseTree(std::move(compound));
+						throw ParserError("Expected 'end' keyword");
+					}
+
+					if (open.empty()) return compound;
+					done = std::move(compound);
+					continue;
+				}
+
+				if (matching(TokenType::BEGIN))
+				{
+					open.emplace_back();
+					open.back().kind = OpenStmt::COMPOUND;
+				}
+				else if (peek(0).type == TokenType::IDENTIFIER && peek(1).type == TokenType::COLON_EQUAL)
+				{
+					done = parseAssignment();
+				}
+				else if (peek(0).type == TokenType::IDENTIFIER
+					&& (peek(1).type == TokenType::SEMICOLON || peek(1).type == TokenType::OPEN_PAREN))
+				{
+					done = parseProcCall();
+				}
+				else if (matching(TokenType::IF))
+				{
+					auto condition = parseExpression();
+					if (match(TokenType::THEN).type == TokenType::NONE)
+					{
+						releaseTree(std::move(condition));
+						throw ParserError("Expected 'then' keyword");
+					}
+
+					open.emplace_back();
+					open.back().kind = OpenStmt::THEN_ARM;
+					open.back().condition = std::move(condition);
+				}
+				else
+				{
+					throw ParserError("Unrecognized statement");
+				}
 			}
 			catch (ParserError& e)
 			{
+				// Statements are recovered by the innermost compound statement,
+				// the ifs inside it are dropped
+				while (!open.empty() && open.back().kind != OpenStmt::COMPOUND)
+				{
+					discard(open.back());
+					open.pop_back();
+				}
+
+				if (open.empty()) throw;
+
 				ReportsManager::ReportError(peek().pos, e.what());
 				synchronise();
 			}
 		}
-		require(TokenType::END, "Expected 'end' keyword");
-		
-		return std::make_unique<AST::CompoundNode>(
-			std::move(t_Stmts)
-		);
 	}
-	
-	std::unique_ptr<AST::StmtNode> Parser::parseStmt()
-	{
-		if (matching(TokenType::BEGIN)) return parseCompound();
-		else if (peek(0).type == TokenType::IDENTIFIER && peek(1).type == TokenType::COLON_EQUAL)
-			return parseAssignment();
-		else if (peek(0).type == TokenType::IDENTIFIER
-			&& (peek(1).type == TokenType::SEMICOLON || peek(1).type == TokenType::OPEN_PAREN))
-			return parseProcCall();
-		else if (matching(TokenType::IF)) return parseIf();
-		else
-		{
-			throw ParserError("Unrecognized statement");
-		}
-	}
-	
-	std::unique_ptr<AST::IfNode> Parser::parseIf()
-	{
-		auto condition = parseExpression();
-		require(TokenType::THEN, "Expected 'then' keyword");
-		auto thenArm = parseStmt();
-		std::unique_ptr<AST::StmtNode> elseArm = nullptr;
-		if (matching(TokenType::ELSE))
-		{
-			if (matching(TokenType::IF)) elseArm = parseIf();
-			else elseArm = parseStmt();
-		}
 
-		return std::make_unique<AST::IfNode>(
-			std::move(condition),
-			std::move(thenArm),
-			std::move(elseArm)
-		);
+	void Parser::discard(OpenStmt& stmt)
+	{
+		for (auto& part : stmt.stmts)
+			releaseTree(std::move(part));
+		releaseTree(std::move(stmt.condition));
+		releaseTree(std::move(stmt.thenArm));
 	}
 
 	std::unique_ptr<AST::AssignmentNode> Parser::parseAssignment()
@@ -248,41 +320,72 @@ namespace Pascal
 	
 	std::unique_ptr<AST::ExpressionNode> Parser::parseExpression()
 	{
-		std::unique_ptr<AST::ExpressionNode> left = parseFactor();
-		
-		while (matching(TokenType::PLUS, TokenType::MINUS))
+		// Expressions enclosing the parenthesized one being parsed, with
+		// the operator before the parenthesis. The first operand has none.
+		struct Enclosing
 		{
-			Token op = previous();
-			std::unique_ptr<AST::ExpressionNode> right = parseFactor();
-			left = std::make_unique<AST::BinaryExprNode>(std::move(left), op, std::move(right));
+			std::unique_ptr<AST::ExpressionNode> left;
+			Token op;
+		};
+
+		std::vector<Enclosing> enclosing;
+		std::unique_ptr<AST::ExpressionNode> left;
+		Token op;
+
+		try
+		{
+			while (true)
+			{
+				if (matching(TokenType::OPEN_PAREN))
+				{
+					enclosing.push_back({ std::move(left), op });
+					op = Token();
+					continue;
+				}
+
+				std::unique_ptr<AST::ExpressionNode> operand = parseUnary();
+
+				while (true)
+				{
+					if (left == nullptr)
+						left = std::move(operand);
+					else
+						left = std::make_unique<AST::BinaryExprNode>(std::move(left), op, std::move(operand));
+
+					if (matching(TokenType::PLUS, TokenType::MINUS))
+					{
+						op = previous();
+						break;
+					}
+
+					if (enclosing.empty())
+						return left;
+
+					require(TokenType::CLOSE_PAREN, "Unbalanced parenthesis");
+
+					operand = std::move(left);
+					left = std::move(enclosing.back().left);
+					op = enclosing.back().op;
+					enclosing.pop_back();
+				}
+			}
 		}
-		
-		return left;
-	}
-	
-	std::unique_ptr<AST::ExpressionNode> Parser::parseFactor()
-	{
-		std::unique_ptr<AST::ExpressionNode> left = parseUnary();
-		
-		while (matching(TokenType::PLUS, TokenType::MINUS))
+		catch (ParserError const&)
 		{
-			Token op = previous();
-			std::unique_ptr<AST::ExpressionNode> right = parseUnary();
-			left = std::make_unique<AST::BinaryExprNode>(std::move(left), op, std::move(right));
+			releaseTree(std::move(left));
+			for (auto& outer : enclosing)
+				releaseTree(std::move(outer.left));
+			throw;
 		}
-		
-		return left;
 	}
 	
 	std::unique_ptr<AST::ExpressionNode> Parser::parseUnary()
 	{
 		if (matching(TokenType::MINUS, TokenType::PLUS))
-			return std::make_unique<AST::UnaryExprNode>(previous(), parsePrimary());
-		else if (matching(TokenType::OPEN_PAREN))
 		{
-			auto expr = parseExpression();
-			require(TokenType::CLOSE_PAREN, "Unbalanced parenthesis");
-			return std::move(expr);
+			// Operands of make_unique are evaluated in any order
+			Token op = previous();
+			return std::make_unique<AST::UnaryExprNode>(op, parsePrimary());
 		}
 		else
 			return parsePrimary();
@@ -0,0 +1,708 @@
+#include <PeepholeOptimizer.hpp>
+
+#include <algorithm>
+#include <map>
+
+namespace Pascal
+{
+	using Chip8::Op;
+
+	namespace
+	{
+		const unsigned FlagReg = 0xF;
+
+		bool isLabel(Chip8::Instr const& instr)
+		{
+			return instr.op == Op::LABEL;
+		}
+
+		bool isInstr(Chip8::Instr const& instr)
+		{
+			return !Chip8::IsPseudo(instr.op);
+		}
+
+		// Instructions between registers only reading the second one
+		bool readsSecond(Op op)
+		{
+			return op == Op::LD || op == Op::ADD || op == Op::SUB || op == Op::SUBN || op == Op::OR ||
+				op == Op::AND || op == Op::XOR || op == Op::SE || op == Op::SNE;
+		}
+
+		const unsigned AllRegs = 0xFFFF;
+
+		unsigned range(int last)
+		{
+			return last < 0 ? 0 : (2u << last) - 1;
+		}
+
+		uint64_t saturatingMul(uint64_t l, uint64_t r)
+		{
+			const uint64_t Max = UINT64_MAX / 2;
+			if (l != 0 && r > Max / l) return Max;
+			return l * r;
+		}
+	}
+
+	bool PeepholeOptimizer::Address::operator==(Address const& other) const
+	{
+		return label == other.label && regs == other.regs && (offset & 0xFFFF) == (other.offset & 0xFFFF);
+	}
+
+	void PeepholeOptimizer::State::reset()
+	{
+		for (unsigned reg = 0; reg < 16; reg++)
+			write(reg);
+
+		iKnown = false;
+		stored = false;
+	}
+
+	void PeepholeOptimizer::State::write(unsigned reg, int value)
+	{
+		known[reg] = value;
+		versions[reg]++;
+		copyOf[reg] = -1;
+	}
+
+	PeepholeOptimizer::PeepholeOptimizer(std::vector<std::string> const& functions)
+		: functions(functions), removed(0), cyclesSaved(0)
+	{ }
+
+	void PeepholeOptimizer::run(Chip8::Code& code)
+	{
+		removed = 0;
+		cyclesSaved = 0;
+
+		load(code);
+		estimateExecutions();
+
+		for (bool changed = true; changed;)
+		{
+			changed = matchPairs();
+			changed = propagate() || changed;
+			changed = removeDeadWrites() || changed;
+		}
+
+		code.instrs.clear();
+		for (auto const& line : lines)
+		{
+			if (!line.removed)
+				code.instrs.push_back(line.instr);
+		}
+	}
+
+	void PeepholeOptimizer::printStats(std::ostream& out) const
+	{
+		out << "Peephole: " << removed << " instructions removed (" << removed * 2 << " bytes), up to "
+			<< cyclesSaved << " cycles saved per run." << std::endl;
+	}
+
+	void PeepholeOptimizer::load(Chip8::Code const& code)
+	{
+		functionOf.assign(code.labelsCount(), -1);
+		for (unsigned i = 0; i < functions.size(); i++)
+		{
+			unsigned label = code.findLabel(functions[i]);
+			if (label != Chip8::NoLabel) functionOf[label] = static_cast<int>(i);
+		}
+
+		lines.clear();
+		lines.reserve(code.instrs.size());
+
+		unsigned function = 0;
+		for (auto const& instr : code.instrs)
+		{
+			if (isLabel(instr) && functionOf[instr.label] >= 0)
+				function = static_cast<unsigned>(functionOf[instr.label]);
+
+			Line line;
+			line.instr = instr;
+			line.function = function;
+			lines.push_back(line);
+		}
+	}
+
+	void PeepholeOptimizer::estimateExecutions()
+	{
+		// Every call site counts, as if all branches were taken
+		std::vector<std::map<unsigned, uint64_t>> calls(functions.size());
+
+		for (auto const& line : lines)
+		{
+			if (line.instr.op != Op::CALL || line.instr.label == Chip8::NoLabel) continue;
+
+			int callee = functionOf[line.instr.label];
+			if (callee >= 0 && line.function < functions.size())
+				calls[line.function][static_cast<unsigned>(callee)]++;
+		}
+
+		executions.assign(std::max<size_t>(functions.size(), 1), 0);
+		if (functions.empty())
+		{
+			executions[0] = 1;
+			return;
+		}
+
+		std::vector<unsigned> callers(functions.size(), 0);
+		for (auto const& callees : calls)
+		{
+			for (auto const& call : callees)
+				callers[call.first]++;
+		}
+
+		// Callers before callees. Recursive functions are never ready,
+		// they keep what the other callers gave them.
+		std::vector<unsigned> ready;
+		for (unsigned f = 0; f < functions.size(); f++)
+		{
+			if (callers[f] == 0) ready.push_back(f);
+		}
+		executions[0] = 1;
+
+		while (!ready.empty())
+		{
+			unsigned f = ready.back();
+			ready.pop_back();
+
+			for (auto const& call : calls[f])
+			{
+				executions[call.first] = std::min(UINT64_MAX / 2, executions[call.first] + saturatingMul(executions[f], call.second));
+				if (--callers[call.first] == 0) ready.push_back(call.first);
+			}
+		}
+
+		for (auto& count : executions)
+			count = std::max<uint64_t>(count, 1);
+	}
+
+	bool PeepholeOptimizer::matchPairs()
+	{
+		bool changed = false;
+		bool afterSkip = false;
+
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			Line& line = lines[i];
+			Chip8::Instr& instr = line.instr;
+			if (line.removed || instr.op == Op::COMMENT) continue;
+
+			if (isLabel(instr))
+			{
+				afterSkip = false;
+				continue;
+			}
+
+			bool skipped = afterSkip;
+			afterSkip = Chip8::IsSkip(instr.op);
+			if (skipped) continue;
+
+			// ld vX, vX; add vX, 0
+			if ((instr.op == Op::LD && instr.x == instr.y) || (instr.op == Op::ADD_IMM && (instr.imm & 0xFF) == 0))
+			{
+				remove(i);
+				changed = true;
+				continue;
+			}
+
+			size_t j = next(i);
+			if (j == lines.size()) continue;
+			Chip8::Instr const& following = lines[j].instr;
+
+			// jp [L] right before L:
+			if (instr.op == Op::JP && instr.imm == 0 && isLabel(following))
+			{
+				for (size_t k = j; k < lines.size() && isLabel(lines[k].instr); k = next(k))
+				{
+					if (lines[k].instr.label == instr.label)
+					{
+						remove(i);
+						changed = true;
+						break;
+					}
+				}
+				continue;
+			}
+
+			if (!isInstr(following)) continue;
+
+			// ld vX, a; add vX, b and add vX, a; add vX, b. Immediate adds
+			// don't touch vF.
+			if ((instr.op == Op::LD_IMM || instr.op == Op::ADD_IMM) &&
+				following.op == Op::ADD_IMM && following.x == instr.x)
+			{
+				instr.imm = static_cast<uint16_t>((instr.imm + following.imm) & 0xFF);
+				remove(j);
+				changed = true;
+				continue;
+			}
+
+			// ld vA, vB; ld vB, vA
+			if (instr.op == Op::LD && following.op == Op::LD && following.x == instr.y && following.y == instr.x)
+			{
+				remove(j);
+				changed = true;
+				continue;
+			}
+		}
+
+		return changed;
+	}
+
+	bool PeepholeOptimizer::propagate()
+	{
+		bool changed = false;
+		bool afterSkip = false;
+
+		State state;
+		for (unsigned reg = 0; reg < 16; reg++)
+			state.versions[reg] = 0;
+		state.reset();
+
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			Line& line = lines[i];
+			Chip8::Instr& instr = line.instr;
+			if (line.removed || instr.op == Op::COMMENT) continue;
+
+			if (isLabel(instr))
+			{
+				state.reset();
+				afterSkip = false;
+				continue;
+			}
+
+			bool conditional = afterSkip;
+			afterSkip = Chip8::IsSkip(instr.op);
+
+			// The register holds the value already
+			if (!conditional && instr.op == Op::LD_IMM && state.known[instr.x] == static_cast<int>(instr.imm & 0xFF))
+			{
+				remove(i);
+				changed = true;
+				continue;
+			}
+
+			if (!conditional && instr.op == Op::LD_I && instr.label != Chip8::NoLabel)
+			{
+				// The run computing the address: adds to I and loads of the
+				// registers added
+				Address address;
+				address.label = instr.label;
+				address.offset = instr.imm;
+
+				State scratch = state;
+				std::vector<size_t> run = { i };
+
+				size_t j = next(i);
+				for (; j < lines.size() && isInstr(lines[j].instr); j = next(j))
+				{
+					Chip8::Instr const& step = lines[j].instr;
+
+					if (step.op == Op::ADD_I)
+					{
+						if (scratch.known[step.x] >= 0)
+							address.offset += static_cast<unsigned>(scratch.known[step.x]);
+						else
+							address.regs.emplace_back(step.x, scratch.versions[step.x]);
+
+						run.push_back(j);
+						continue;
+					}
+
+					size_t after = next(j);
+					if (step.op == Op::LD_IMM && after < lines.size() &&
+						lines[after].instr.op == Op::ADD_I && lines[after].instr.x == step.x)
+					{
+						apply(scratch, step, false);
+						continue;
+					}
+
+					break;
+				}
+
+				// Value stored there is still in the registers
+				int reloaded = -1;
+				if (j < lines.size() && lines[j].instr.op == Op::LOAD)
+					reloaded = lines[j].instr.x;
+
+				bool forwarded = reloaded >= 0 && state.stored && state.storeAddress == address &&
+					static_cast<unsigned>(reloaded) < state.storeCount;
+				for (int reg = 0; forwarded && reg <= reloaded; reg++)
+					forwarded = scratch.versions[reg] == state.storeVersions[reg];
+
+				if (forwarded || (state.iKnown && state.i == address))
+				{
+					for (size_t k : run)
+						remove(k);
+					if (forwarded)
+						remove(j);
+
+					changed = true;
+					continue;
+				}
+			}
+
+			// Read the register a copy was made from
+			if (!conditional && readsSecond(instr.op) && state.copyOf[instr.y] >= 0 &&
+				state.versions[state.copyOf[instr.y]] == state.copyVersions[instr.y])
+			{
+				instr.y = static_cast<uint8_t>(state.copyOf[instr.y]);
+				changed = true;
+			}
+
+			apply(state, instr, conditional);
+		}
+
+		return changed;
+	}
+
+	bool PeepholeOptimizer::removeDeadWrites()
+	{
+		bool changed = false;
+
+		// Whether the instruction may be skipped
+		std::vector<bool> conditional(lines.size(), false);
+		bool afterSkip = false;
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			if (lines[i].removed || lines[i].instr.op == Op::COMMENT) continue;
+
+			conditional[i] = afterSkip;
+			afterSkip = Chip8::IsSkip(lines[i].instr.op);
+		}
+
+		std::vector<size_t> labelLines(functionOf.size(), lines.size());
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			if (!lines[i].removed && isLabel(lines[i].instr))
+				labelLines[lines[i].instr.label] = i;
+		}
+
+		// Registers read later on some path, before every line. Calls,
+		// returns and indirect jumps read everything.
+		std::vector<unsigned> liveIn(lines.size(), 0);
+		for (bool updated = true; updated;)
+		{
+			updated = false;
+
+			for (size_t i = lines.size(); i-- > 0;)
+			{
+				Line const& line = lines[i];
+				if (line.removed || line.instr.op == Op::COMMENT) continue;
+
+				unsigned live = liveOut(i, liveIn, labelLines);
+				if (!isLabel(line.instr) && line.instr.op != Op::JP)
+				{
+					unsigned uses = 0, defs = 0;
+					effects(line.instr, uses, defs);
+
+					// A skipped write doesn't end the old value
+					if (!conditional[i]) live &= ~defs;
+					live |= uses;
+				}
+
+				if (live != liveIn[i])
+				{
+					liveIn[i] = live;
+					updated = true;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			Line const& line = lines[i];
+			if (line.removed || !isInstr(line.instr) || conditional[i]) continue;
+
+			unsigned uses = 0, defs = 0;
+			bool pure = effects(line.instr, uses, defs);
+
+			if (pure && defs != 0 && (defs & liveOut(i, liveIn, labelLines)) == 0)
+			{
+				remove(i);
+				changed = true;
+			}
+		}
+
+		return changed;
+	}
+
+	unsigned PeepholeOptimizer::liveOut(size_t line, std::vector<unsigned> const& liveIn,
+		std::vector<size_t> const& labelLines) const
+	{
+		auto liveAt = [&](size_t i) { return i < lines.size() ? liveIn[i] : AllRegs; };
+
+		Chip8::Instr const& instr = lines[line].instr;
+		switch (instr.op)
+		{
+		case Op::JP:
+			if (instr.label == Chip8::NoLabel || instr.imm != 0)
+				return AllRegs;
+			return liveAt(labelLines[instr.label]);
+
+		case Op::JP_V0:
+		case Op::RET:
+		case Op::DATA:
+			return AllRegs;
+
+		default:
+			break;
+		}
+
+		size_t following = next(line);
+		if (!Chip8::IsSkip(instr.op))
+			return liveAt(following);
+
+		// The skipped instruction, or the one after it
+		size_t skipped = following;
+		while (skipped < lines.size() && !isInstr(lines[skipped].instr))
+			skipped = next(skipped);
+
+		return liveAt(following) | liveAt(skipped < lines.size() ? next(skipped) : skipped);
+	}
+
+	bool PeepholeOptimizer::effects(Chip8::Instr const& instr, unsigned& uses, unsigned& defs)
+	{
+		unsigned bitX = 1u << instr.x;
+		unsigned bitY = 1u << instr.y;
+
+		uses = defs = 0;
+
+		switch (instr.op)
+		{
+		case Op::LD:
+			uses = bitY;
+			defs = bitX;
+			return true;
+
+		case Op::LD_IMM:
+			defs = bitX;
+			return true;
+
+		case Op::LOAD:
+			defs = range(instr.x);
+			return true;
+
+		case Op::STORE:
+			uses = range(instr.x);
+			return false;
+
+		case Op::LD_I:
+			return false;
+
+		// Timers, keys, BCD and font
+		case Op::LD_DT_TO:
+		case Op::LD_KEY:
+			defs = bitX;
+			return false;
+
+		case Op::LD_DT:
+		case Op::LD_ST:
+		case Op::LD_F:
+		case Op::LD_B:
+		case Op::ADD_I:
+			uses = bitX;
+			return false;
+
+		case Op::ADD_IMM:
+			uses = defs = bitX;
+			return true;
+
+		case Op::ADD:
+		case Op::SUB:
+		case Op::SUBN:
+		case Op::OR:
+		case Op::AND:
+		case Op::XOR:
+			uses = bitX | bitY;
+			defs = bitX | (1u << FlagReg);
+			return true;
+
+		case Op::SHR:
+		case Op::SHL:
+			uses = bitX;
+			defs = bitX | (1u << FlagReg);
+			return true;
+
+		case Op::SE_IMM:
+		case Op::SNE_IMM:
+		case Op::SKP:
+		case Op::SKNP:
+			uses = bitX;
+			return false;
+
+		case Op::SE:
+		case Op::SNE:
+			uses = bitX | bitY;
+			return false;
+
+		case Op::DRW:
+			uses = bitX | bitY;
+			defs = 1u << FlagReg;
+			return false;
+
+		case Op::CLS:
+			return false;
+
+		case Op::SYS:
+			if (instr.imm == 0 && instr.label == Chip8::NoLabel)
+				return false;
+			break;
+
+		default:
+			break;
+		}
+
+		// Jumps, calls, returns and anything else
+		uses = AllRegs;
+		return false;
+	}
+
+	void PeepholeOptimizer::apply(State& state, Chip8::Instr const& instr, bool conditional) const
+	{
+		unsigned x = instr.x;
+		unsigned y = instr.y;
+
+		// A skipped instruction leaves either state behind
+		auto write = [&](unsigned reg, int value) {
+			state.write(reg, conditional ? -1 : value);
+		};
+
+		switch (instr.op)
+		{
+		case Op::LD:
+			write(x, state.known[y]);
+			if (!conditional)
+			{
+				state.copyOf[x] = static_cast<int>(y);
+				state.copyVersions[x] = state.versions[y];
+			}
+			break;
+
+		case Op::LOAD:
+			for (unsigned reg = 0; reg <= x; reg++)
+				write(reg, -1);
+			state.iKnown = false;
+			break;
+
+		case Op::LD_IMM:
+			write(x, static_cast<int>(instr.imm & 0xFF));
+			break;
+
+		case Op::LD_DT_TO:
+		case Op::LD_KEY:
+			write(x, -1);
+			break;
+
+		case Op::LD_I:
+			state.iKnown = !conditional && instr.label != Chip8::NoLabel;
+			state.i = Address();
+			state.i.label = instr.label;
+			state.i.offset = instr.imm;
+			break;
+
+		case Op::STORE:
+			state.stored = !conditional && state.iKnown;
+			if (state.stored)
+			{
+				state.storeAddress = state.i;
+				state.storeCount = x + 1;
+				std::copy(state.versions, state.versions + 16, state.storeVersions);
+			}
+			state.iKnown = false;
+			break;
+
+		case Op::LD_B:
+			state.stored = false;
+			break;
+
+		case Op::LD_F:
+			state.iKnown = false;
+			break;
+
+		case Op::LD_DT:
+		case Op::LD_ST:
+			break;
+
+		case Op::ADD_I:
+			if (state.iKnown && !conditional)
+			{
+				if (state.known[x] >= 0)
+					state.i.offset += static_cast<unsigned>(state.known[x]);
+				else
+					state.i.regs.emplace_back(x, state.versions[x]);
+			}
+			else state.iKnown = false;
+			break;
+
+		case Op::ADD:
+			write(x, -1);
+			write(FlagReg, -1);
+			break;
+
+		case Op::ADD_IMM:
+			write(x, state.known[x] >= 0 ? static_cast<int>((state.known[x] + instr.imm) & 0xFF) : -1);
+			break;
+
+		case Op::SUB:
+		case Op::SUBN:
+		case Op::OR:
+		case Op::AND:
+		case Op::XOR:
+		case Op::SHR:
+		case Op::SHL:
+		case Op::RND:
+			write(x, -1);
+			write(FlagReg, -1);
+			break;
+
+		case Op::DRW:
+			write(FlagReg, -1);
+			break;
+
+		case Op::SE_IMM:
+		case Op::SNE_IMM:
+		case Op::SE:
+		case Op::SNE:
+		case Op::SKP:
+		case Op::SKNP:
+		case Op::CLS:
+			break;
+
+		case Op::SYS:
+			if (instr.imm != 0 || instr.label != Chip8::NoLabel)
+				state.reset();
+			break;
+
+		case Op::JP:
+		case Op::JP_V0:
+		case Op::RET:
+			// Code after them is reached only through a label
+			if (!conditional) state.reset();
+			break;
+
+		default:
+			state.reset();
+			break;
+		}
+	}
+
+	void PeepholeOptimizer::remove(size_t line)
+	{
+		lines[line].removed = true;
+
+		removed++;
+		cyclesSaved += executions[std::min<size_t>(lines[line].function, executions.size() - 1)];
+	}
+
+	size_t PeepholeOptimizer::next(size_t line) const
+	{
+		for (line++; line < lines.size(); line++)
+		{
+			if (!lines[line].removed && lines[line].instr.op != Op::COMMENT)
+				return line;
+		}
+
+		return lines.size();
+	}
+} // namespace Pascal
@@ -0,0 +1,451 @@
+#include <RegisterAllocator.hpp>
+
+#include <algorithm>
+#include <climits>
+
+namespace Pascal
+{
+	using IR::Opcode;
+	using IR::Width;
+	using IR::VReg;
+
+	namespace
+	{
+		unsigned countFree(unsigned freeRegs)
+		{
+			unsigned res = 0;
+			for (; freeRegs != 0; freeRegs &= freeRegs - 1)
+				res++;
+
+			return res;
+		}
+
+		uint8_t takeFree(unsigned& freeRegs)
+		{
+			for (uint8_t reg = RegisterAllocator::FirstRegister; reg <= RegisterAllocator::LastRegister; reg++)
+			{
+				if (freeRegs & (1u << reg))
+				{
+					freeRegs &= ~(1u << reg);
+					return reg;
+				}
+			}
+
+			return Location::NoRegister;
+		}
+
+		template<typename F>
+		void forEachUse(IR::Instr& instr, F f)
+		{
+			if (instr.a != IR::NoReg) f(instr.a);
+			if (instr.b != IR::NoReg) f(instr.b);
+		}
+
+		template<typename F>
+		void forEachUse(IR::Instr const& instr, F f)
+		{
+			if (instr.a != IR::NoReg) f(instr.a);
+			if (instr.b != IR::NoReg) f(instr.b);
+		}
+
+		std::vector<unsigned> successors(IR::BasicBlock const& block)
+		{
+			IR::Instr const& last = block.terminator();
+
+			switch (last.op)
+			{
+			case Opcode::JUMP:
+				return { last.target };
+			case Opcode::BRANCH:
+				return { last.target, last.elseTarget };
+			default:
+				return {};
+			}
+		}
+	}
+
+	Allocation RegisterAllocator::allocate(IR::Function& function)
+	{
+		promoteLocals(function);
+		std::vector<Range> ranges = buildRanges(function);
+
+		std::sort(ranges.begin(), ranges.end(), [](Range const& l, Range const& r) {
+			return l.start < r.start || (l.start == r.start && l.reg < r.reg);
+		});
+
+		Allocation res;
+		res.locations.resize(function.vregs.size());
+
+		unsigned freeRegs = 0;
+		for (unsigned reg = FirstRegister; reg <= LastRegister; reg++)
+			freeRegs |= 1u << reg;
+
+		auto release = [&](Range const& range) {
+			Location const& location = res.locations[range.reg];
+			freeRegs |= 1u << location.lo;
+			if (location.hi != Location::NoRegister)
+				freeRegs |= 1u << location.hi;
+		};
+
+		std::vector<Range> active;
+		std::vector<VReg> spilled;
+
+		for (auto const& range : ranges)
+		{
+			for (auto it = active.begin(); it != active.end();)
+			{
+				if (it->end < range.start)
+				{
+					release(*it);
+					it = active.erase(it);
+				}
+				else ++it;
+			}
+
+			unsigned needed = static_cast<unsigned>(function.vregs[range.reg]);
+			bool spill = false;
+
+			while (countFree(freeRegs) < needed)
+			{
+				auto victim = std::min_element(active.begin(), active.end(), [](Range const& l, Range const& r) {
+					return l.weight() < r.weight();
+				});
+
+				if (victim == active.end() || victim->weight() >= range.weight())
+				{
+					spill = true;
+					break;
+				}
+
+				release(*victim);
+				res.locations[victim->reg] = Location();
+				spilled.push_back(victim->reg);
+				active.erase(victim);
+			}
+
+			if (spill)
+			{
+				spilled.push_back(range.reg);
+				continue;
+			}
+
+			Location& location = res.locations[range.reg];
+			location.lo = takeFree(freeRegs);
+			if (needed == 2)
+				location.hi = takeFree(freeRegs);
+
+			active.push_back(range);
+		}
+
+		unsigned offset = function.frame.size();
+		for (VReg reg : spilled)
+		{
+			if (homes[reg] >= 0)
+			{
+				res.locations[reg].offset = static_cast<unsigned>(homes[reg]);
+				continue;
+			}
+
+			res.locations[reg].offset = offset;
+			offset += static_cast<unsigned>(function.vregs[reg]);
+		}
+
+		if (!function.isMain())
+		{
+			for (auto const& location : res.locations)
+			{
+				if (!location.inRegister()) continue;
+
+				res.lastRegister = std::max<unsigned>(res.lastRegister, location.lo);
+				if (location.hi != Location::NoRegister)
+					res.lastRegister = std::max<unsigned>(res.lastRegister, location.hi);
+			}
+
+			if (res.savesRegisters())
+			{
+				res.saveOffset = offset;
+				offset += res.lastRegister + 1;
+			}
+		}
+
+		res.frameSize = offset;
+		return res;
+	}
+
+	Allocation RegisterAllocator::SpillAll(IR::Function const& function)
+	{
+		Allocation res;
+		res.locations.resize(function.vregs.size());
+
+		unsigned offset = function.frame.size();
+		for (VReg reg = 0; reg < function.vregs.size(); reg++)
+		{
+			res.locations[reg].offset = offset;
+			offset += static_cast<unsigned>(function.vregs[reg]);
+		}
+
+		res.frameSize = offset;
+		return res;
+	}
+
+	void RegisterAllocator::promoteLocals(IR::Function& function)
+	{
+		homes.assign(function.vregs.size(), -1);
+
+		std::vector<unsigned> uses(function.vregs.size(), 0);
+		for (auto const& block : function.blocks)
+		{
+			for (auto const& instr : block.instrs)
+				forEachUse(instr, [&](VReg reg) { uses[reg]++; });
+		}
+
+		// A load can be replaced by the register of its variable when the
+		// value is used in the same block, before the variable is stored to
+		std::vector<bool> replaceable(function.vregs.size(), false);
+		std::vector<unsigned> loadedSlot(function.vregs.size());
+		std::vector<unsigned> loadedStores(function.vregs.size());
+		std::vector<unsigned> loadedBlock(function.vregs.size());
+		std::vector<unsigned> stores(function.frame.count(), 0);
+
+		for (unsigned b = 0; b < function.blocks.size(); b++)
+		{
+			for (auto const& instr : function.blocks[b].instrs)
+			{
+				forEachUse(instr, [&](VReg reg) {
+					if (replaceable[reg] && (loadedBlock[reg] != b || loadedStores[reg] != stores[loadedSlot[reg]]))
+						replaceable[reg] = false;
+				});
+
+				if (instr.op == Opcode::LOAD && !instr.var.isGlobal())
+				{
+					replaceable[instr.dst] = true;
+					loadedSlot[instr.dst] = instr.var.slot;
+					loadedStores[instr.dst] = stores[instr.var.slot];
+					loadedBlock[instr.dst] = b;
+				}
+				else if (instr.op == Opcode::STORE && !instr.var.isGlobal())
+				{
+					stores[instr.var.slot]++;
+				}
+			}
+		}
+
+		std::vector<VReg> regOfSlot(function.frame.count(), IR::NoReg);
+		auto regOf = [&](unsigned slot) {
+			if (regOfSlot[slot] == IR::NoReg)
+			{
+				regOfSlot[slot] = function.newVReg(function.frame.sizeOf(slot) == 2 ? Width::WORD : Width::BYTE);
+				homes.push_back(static_cast<int>(function.frame.offset(slot)));
+			}
+
+			return regOfSlot[slot];
+		};
+
+		std::vector<VReg> replacement(function.vregs.size(), IR::NoReg);
+
+		for (auto& block : function.blocks)
+		{
+			std::vector<IR::Instr> instrs;
+			instrs.reserve(block.instrs.size());
+
+			for (auto instr : block.instrs)
+			{
+				forEachUse(instr, [&](VReg& reg) {
+					if (replacement[reg] != IR::NoReg) reg = replacement[reg];
+				});
+
+				if (instr.op == Opcode::LOAD && !instr.var.isGlobal())
+				{
+					VReg local = regOf(instr.var.slot);
+
+					if (replaceable[instr.dst])
+					{
+						replacement[instr.dst] = local;
+						continue;
+					}
+
+					instr.op = Opcode::COPY;
+					instr.a = local;
+					instr.var = IR::Var();
+				}
+				else if (instr.op == Opcode::STORE && !instr.var.isGlobal())
+				{
+					VReg local = regOf(instr.var.slot);
+
+					// x := a + b computes right into x
+					IR::Instr* previous = instrs.empty() ? nullptr : &instrs.back();
+					if (previous != nullptr && previous->dst == instr.a && instr.a < uses.size() &&
+						uses[instr.a] == 1 && previous->width == instr.width)
+					{
+						previous->dst = local;
+						continue;
+					}
+
+					instr.op = Opcode::COPY;
+					instr.dst = local;
+					instr.var = IR::Var();
+				}
+
+				instrs.push_back(instr);
+			}
+
+			block.instrs = std::move(instrs);
+		}
+
+		// Parameters are loaded from their slots on entry
+		unsigned params = function.signature != nullptr ? function.signature->arity() : 0;
+		auto& entry = function.blocks.front().instrs;
+
+		for (unsigned slot = params; slot-- > 0;)
+		{
+			if (regOfSlot[slot] == IR::NoReg) continue;
+
+			IR::Instr load;
+			load.op = Opcode::LOAD;
+			load.width = function.vregs[regOfSlot[slot]];
+			load.dst = regOfSlot[slot];
+			load.var.storage = StorageClass::PARAM;
+			load.var.slot = slot;
+
+			entry.insert(entry.begin(), load);
+		}
+	}
+
+	std::vector<RegisterAllocator::Range> RegisterAllocator::buildRanges(IR::Function const& function) const
+	{
+		size_t count = function.vregs.size();
+		size_t blocks = function.blocks.size();
+
+		// Values read before they are written in some block, the only ones
+		// live across blocks. Others live within the block writing them, so
+		// programs with many blocks have few of these.
+		std::vector<std::vector<VReg>> exposed(blocks), written(blocks);
+		std::vector<unsigned> writtenIn(count, UINT_MAX);
+		std::vector<unsigned> index(count, UINT_MAX);
+		std::vector<VReg> crossing;
+
+		std::vector<unsigned> first(blocks), last(blocks);
+		unsigned position = 0;
+
+		for (unsigned b = 0; b < blocks; b++)
+		{
+			first[b] = position;
+
+			for (auto const& instr : function.blocks[b].instrs)
+			{
+				forEachUse(instr, [&](VReg reg) {
+					if (writtenIn[reg] == b) return;
+
+					exposed[b].push_back(reg);
+					if (index[reg] == UINT_MAX)
+					{
+						index[reg] = static_cast<unsigned>(crossing.size());
+						crossing.push_back(reg);
+					}
+				});
+
+				if (instr.dst != IR::NoReg)
+				{
+					writtenIn[instr.dst] = b;
+					written[b].push_back(instr.dst);
+				}
+
+				position++;
+			}
+
+			last[b] = position - 1;
+		}
+
+		// Liveness of those, by their index
+		size_t live = crossing.size();
+
+		std::vector<std::vector<bool>> used(blocks, std::vector<bool>(live, false));
+		std::vector<std::vector<bool>> defined(blocks, std::vector<bool>(live, false));
+
+		for (unsigned b = 0; b < blocks; b++)
+		{
+			for (VReg reg : exposed[b])
+				used[b][index[reg]] = true;
+			for (VReg reg : written[b])
+			{
+				if (index[reg] != UINT_MAX) defined[b][index[reg]] = true;
+			}
+		}
+
+		std::vector<std::vector<bool>> liveIn(blocks, std::vector<bool>(live, false));
+		std::vector<std::vector<bool>> liveOut(blocks, std::vector<bool>(live, false));
+
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+
+			for (unsigned b = static_cast<unsigned>(blocks); b-- > 0;)
+			{
+				for (unsigned succ : successors(function.blocks[b]))
+				{
+					for (size_t i = 0; i < live; i++)
+					{
+						if (liveIn[succ][i] && !liveOut[b][i])
+						{
+							liveOut[b][i] = true;
+							changed = true;
+						}
+					}
+				}
+
+				for (size_t i = 0; i < live; i++)
+				{
+					bool in = used[b][i] || (liveOut[b][i] && !defined[b][i]);
+					if (in && !liveIn[b][i])
+					{
+						liveIn[b][i] = true;
+						changed = true;
+					}
+				}
+			}
+		}
+
+		// Operands are read at the position where the result is written, so
+		// the result never shares a register with them
+		std::vector<Range> ranges(count);
+		for (VReg reg = 0; reg < count; reg++)
+			ranges[reg] = { reg, UINT_MAX, 0, 0 };
+
+		auto touch = [&](VReg reg, unsigned at) {
+			ranges[reg].start = std::min(ranges[reg].start, at);
+			ranges[reg].end = std::max(ranges[reg].end, at);
+		};
+
+		position = 0;
+		for (unsigned b = 0; b < blocks; b++)
+		{
+			for (auto const& instr : function.blocks[b].instrs)
+			{
+				forEachUse(instr, [&](VReg reg) {
+					touch(reg, position);
+					ranges[reg].uses++;
+				});
+
+				if (instr.dst != IR::NoReg)
+				{
+					touch(instr.dst, position);
+					ranges[instr.dst].uses++;
+				}
+
+				position++;
+			}
+
+			for (size_t i = 0; i < live; i++)
+			{
+				if (liveIn[b][i]) touch(crossing[i], first[b]);
+				if (liveOut[b][i]) touch(crossing[i], last[b]);
+			}
+		}
+
+		ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](Range const& range) {
+			return range.uses == 0;
+		}), ranges.end());
+
+		return ranges;
+	}
+} // namespace Pascal
@@ -3,225 +3,717 @@
 
 #include <iostream>
 #include <algorithm>
+#include <tuple>
 
 namespace Pascal
 {
-	std::vector<ReportFile> ReportsManager::includeStack;
+	namespace
+	{
+		std::atomic<uint64_t> lastContextId(0);
 
-    ReportFile ReportsManager::currentFile;
-	
-	std::vector<ErrorType> ReportsManager::disallowedErrors;
-	std::vector<WarningType> ReportsManager::disallowedWarnings;
+		// Buffer of the current thread in the context it was last used with
+		struct ThreadBufferCache
+		{
+			uint64_t contextId;
+			ReportBuffer* buffer;
+		};
 
-	unsigned ReportsManager::errorsCount = 0;
-	unsigned ReportsManager::warningsCount = 0;
-	
-	bool ReportsManager::treatWarningsAsError;
+		thread_local ThreadBufferCache threadBufferCache = { 0, nullptr };
+
+		// Names for command line options, indexed by the type
+		const char* const errorNames[ErrorTypesCount] =
+		{
+			nullptr,
+			"illegal-letter",
+			"unexpected-word",
+			"expected",
+			"name-undefined",
+			"name-redefinition",
+			"illegal-assignment",
+			"illegal-statement",
+			"calling-non-procedure",
+			"calling-non-function",
+			"wrong-arguments-count",
+			"procedure-as-function",
+			"cant-parse-literal",
+			"division-by-zero",
+			"unterminated-string",
+			"illegal-char"
+		};
+
+		const char* const warningNames[WarningTypesCount] =
+		{
+			nullptr,
+			"uninitialized-var",
+			"unused-var",
+			"unknown-escape-char"
+		};
+
+		// Handles '<prefix><name>' and '<prefix>no-<name>'
+		template <size_t N>
+		void parseTypeOption(std::string const& arg, char prefix, const char* const (&names)[N],
+							 std::bitset<N>& disallowed)
+		{
+			if (arg.size() < 2 || arg[0] != '-' || arg[1] != prefix) return;
+
+			std::string name = arg.substr(2);
+			bool disable = name.compare(0, 3, "no-") == 0;
+			if (disable) name.erase(0, 3);
+
+			for (size_t i = 1; i < N; i++)
+			{
+				if (name == names[i])
+				{
+					disallowed[i] = disable;
+					return;
+				}
+			}
+		}
+
+		unsigned parseCount(std::string const& arg, std::string const& option)
+		{
+			if (arg.compare(0, option.size(), option) != 0) return 0;
+			return static_cast<unsigned>(std::strtoul(arg.c_str() + option.size(), nullptr, 10));
+		}
+	}
+
+	ReportsContext::ReportsContext()
+		: warningsCount(0), errorsCount(0), maxErrors(0), categoryLimit(0),
+		  suppressedCount(0), hiddenCount(0), maxErrorsReached(false), treatWarningsAsError(false),
+		  format(DiagnosticsFormat::TEXT), listener(nullptr), output(&std::cout), buffers(nullptr),
+		  id(++lastContextId)
+	{
+		for (auto& count : errorsByType) count = 0;
+		for (auto& count : warningsByType) count = 0;
+	}
+
+	ReportsContext::~ReportsContext()
+	{
+		ReportBuffer* buffer = buffers.load();
+		while (buffer != nullptr)
+		{
+			ReportBuffer* next = buffer->next;
+			delete buffer;
+			buffer = next;
+		}
+	}
+
+	ReportBuffer& ReportsContext::threadBuffer()
+	{
+		if (threadBufferCache.contextId == id)
+			return *threadBufferCache.buffer;
 
-	std::string tabTransform(std::string const& work)
+		std::thread::id self = std::this_thread::get_id();
+
+		// The thread may have already reported here before switching to
+		// another context
+		ReportBuffer* buffer = buffers.load(std::memory_order_acquire);
+		while (buffer != nullptr && buffer->owner != self)
+			buffer = buffer->next;
+
+		if (buffer == nullptr)
+		{
+			buffer = new ReportBuffer();
+			buffer->owner = self;
+			buffer->dropping = false;
+			buffer->next = buffers.load(std::memory_order_relaxed);
+			while (!buffers.compare_exchange_weak(buffer->next, buffer,
+												  std::memory_order_release,
+												  std::memory_order_relaxed))
+			{ }
+		}
+
+		threadBufferCache = { id, buffer };
+		return *buffer;
+	}
+
+	void ReportsContext::clearBuffers()
 	{
-		std::stringstream ss;
-		for (char ch : work)
+		// Buffers themselves are kept, threads may still have them cached
+		for (ReportBuffer* buffer = buffers.load(); buffer != nullptr; buffer = buffer->next)
 		{
-			if (ch == '\t')
+			buffer->records.clear();
+			buffer->recordsAt.clear();
+			buffer->dropping = false;
+		}
+	}
+
+	thread_local ReportsContext* ReportsManager::context = nullptr;
+
+	ReportsContext& ReportsManager::Current()
+	{
+		static thread_local ReportsContext defaultContext;
+		return context != nullptr ? *context : defaultContext;
+	}
+
+	void ReportsManager::SetContext(ReportsContext* newContext)
+	{
+		context = newContext;
+	}
+
+	ReportsContext* ReportsManager::GetContext()
+	{
+		return context;
+	}
+
+	namespace
+	{
+		void appendTabTransformed(std::string& out, std::string const& source, size_t from, size_t to)
+		{
+			for (size_t i = from; i < to && i < source.size(); i++)
 			{
-				ss << "    ";
+				if (source[i] == '\t')
+				{
+					out += "    ";
+				}
+				else
+				{
+					out += source[i];
+				}
 			}
-			else
+		}
+
+		void appendJsonString(std::string& out, std::string const& str)
+		{
+			static const char hex[] = "0123456789abcdef";
+
+			out += '"';
+			for (char ch : str)
 			{
-				ss << ch;
+				switch (ch)
+				{
+				case '"':  out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\r': out += "\\r"; break;
+				case '\t': out += "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(ch) < 0x20)
+					{
+						out += "\\u00";
+						out += hex[(ch >> 4) & 0xF];
+						out += hex[ch & 0xF];
+					}
+					else
+					{
+						out += ch;
+					}
+				}
 			}
+			out += '"';
+		}
+
+		const char* severity(ReportType type)
+		{
+			switch (type)
+			{
+			case ReportType::ERROR:
+				return "error";
+			case ReportType::WARNING:
+				return "warning";
+			case ReportType::NOTE:
+				return "note";
+			}
+			return "";
 		}
-		return ss.str();
 	}
-	
+
     void ReportsManager::Init(const std::vector<std::string> &args)
 	{
-		if (find(args.begin(), args.end(), "-Wall") != args.end())
+		ReportsContext& ctx = Current();
+
+		ctx.disallowedErrors.reset();
+		ctx.disallowedWarnings.reset();
+		ctx.maxErrors = 0;
+		ctx.categoryLimit = 0;
+
+		for (auto const& arg : args)
 		{
-			disallowedWarnings.clear();
+			if (arg == "-Wall")
+			{
+				ctx.disallowedWarnings.reset();
+			}
+			else if (arg == "-Eall")
+			{
+			    ctx.disallowedErrors.reset();
+			}
+			else if (arg.rfind("-fmax-errors=", 0) == 0)
+			{
+				ctx.maxErrors = parseCount(arg, "-fmax-errors=");
+			}
+			else if (arg.rfind("-fdiagnostics-category-limit=", 0) == 0)
+			{
+				ctx.categoryLimit = parseCount(arg, "-fdiagnostics-category-limit=");
+			}
+			else
+			{
+				parseTypeOption(arg, 'W', warningNames, ctx.disallowedWarnings);
+				parseTypeOption(arg, 'E', errorNames, ctx.disallowedErrors);
+			}
 		}
 
-		if (find(args.begin(), args.end(), "-Eall") != args.end())
+		ctx.format = DiagnosticsFormat::TEXT;
+		for (auto const& arg : args)
 		{
-		    disallowedErrors.clear();
+			if (arg == "-fdiagnostics-format=json")
+				ctx.format = DiagnosticsFormat::JSON;
+			else if (arg == "-fdiagnostics-format=sarif")
+				ctx.format = DiagnosticsFormat::SARIF;
+			else if (arg == "-fdiagnostics-format=text")
+				ctx.format = DiagnosticsFormat::TEXT;
 		}
 
 		if (find(args.begin(), args.end(), "-Werror") != args.end())
 		{
-		    treatWarningsAsError = true;
+		    ctx.treatWarningsAsError = true;
+		}
+		else
+		{
+			ctx.treatWarningsAsError = false;
+		}
+	}
+
+	void ReportsManager::Reset()
+	{
+		ReportsContext& ctx = Current();
+
+		ctx.errorsCount = 0;
+		ctx.warningsCount = 0;
+		ctx.suppressedCount = 0;
+		ctx.hiddenCount = 0;
+		ctx.maxErrorsReached = false;
+		for (auto& count : ctx.errorsByType) count = 0;
+		for (auto& count : ctx.warningsByType) count = 0;
+		ctx.includeStack.clear();
+		ctx.clearBuffers();
+	}
+
+	void ReportsManager::Flush()
+	{
+		ReportsContext& ctx = Current();
+
+		// Report together with the notes following it
+		struct Group
+		{
+			ReportBuffer::Record const* first;
+			size_t size;
+		};
+
+		std::vector<Group> groups;
+		for (ReportBuffer* buffer = ctx.buffers.load(); buffer != nullptr; buffer = buffer->next)
+		{
+			auto const& records = buffer->records;
+			for (size_t i = 0; i < records.size(); i++)
+			{
+				if (records[i].type == ReportType::NOTE && i != 0)
+					groups.back().size++;
+				else
+					groups.push_back({ &records[i], 1 });
+			}
+		}
+
+		// Same order whatever threads made the reports
+		std::stable_sort(groups.begin(), groups.end(), [](Group const& a, Group const& b)
+		{
+			return std::tie(a.first->where, a.first->type, a.first->msg) <
+				std::tie(b.first->where, b.first->type, b.first->msg);
+		});
+
+		// Duplicates from different threads. Those from the same thread
+		// were dropped when reported.
+		groups.erase(std::unique(groups.begin(), groups.end(), [](Group const& a, Group const& b)
+		{
+			return a.first->where == b.first->where && a.first->type == b.first->type &&
+				a.first->msg == b.first->msg;
+		}), groups.end());
+
+		std::vector<size_t> lineStarts;
+		if (!groups.empty())
+		{
+			std::string const& source = *ctx.currentFile.source;
+
+			lineStarts.push_back(0);
+			for (size_t i = 0; i < source.size(); i++)
+			{
+				if (source[i] == '\n')
+					lineStarts.push_back(i + 1);
+			}
+		}
+
+		std::string out;
+
+		if (ctx.format == DiagnosticsFormat::SARIF)
+		{
+			out += "{\"version\":\"2.1.0\",\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+				"\"runs\":[{\"tool\":{\"driver\":{\"name\":\"PascalInt3\"}},\"results\":[";
+
+			for (size_t i = 0; i < groups.size(); i++)
+			{
+				if (i != 0) out += ',';
+				formatSarif(out, groups[i].first, groups[i].size, lineStarts);
+			}
+
+			out += "]}]}\n";
 		}
 		else
 		{
-			treatWarningsAsError = false;
+			for (auto const& group : groups)
+			{
+				for (size_t i = 0; i < group.size; i++)
+				{
+					if (ctx.format == DiagnosticsFormat::JSON)
+						formatJson(out, group.first[i], lineStarts);
+					else
+						formatText(out, group.first[i], lineStarts);
+				}
+			}
+
+			if (ctx.format == DiagnosticsFormat::TEXT)
+			{
+				if (ctx.suppressedCount > 0)
+				{
+					out += std::to_string(ctx.suppressedCount) + " more reports suppressed by -fdiagnostics-category-limit=" +
+						std::to_string(ctx.categoryLimit) + "\n";
+				}
+
+				if (ctx.hiddenCount > 0)
+				{
+					out += std::to_string(ctx.hiddenCount) + " errors hidden by -Eno-<name>\n";
+				}
+
+				if (ctx.maxErrorsReached)
+				{
+					out += "compilation terminated due to -fmax-errors=" + std::to_string(ctx.maxErrors) + ".\n";
+				}
+			}
 		}
+
+		ctx.output->write(out.data(), out.size());
+		ctx.output->flush();
+
+		ctx.clearBuffers();
+		ctx.suppressedCount = 0;
+		ctx.hiddenCount = 0;
+	}
+
+	void ReportsManager::SetOutput(std::ostream* newOutput)
+	{
+		Current().output = newOutput;
+	}
+
+	DiagnosticsFormat ReportsManager::GetFormat()
+	{
+		return Current().format;
 	}
 
 	void ReportsManager::SetCurrentFile(ReportFile const& file)
 	{
-		currentFile = file;
+		Current().currentFile = file;
 	}
 
 	void ReportsManager::PushInclude(ReportFile const& file)
 	{
-		includeStack.push_back(file);
+		Current().includeStack.push_back(file);
 	}
 
     ReportFile ReportsManager::PopInclude()
 	{
-		ReportFile temp = includeStack.front();
-		includeStack.pop_back();
+		ReportsContext& ctx = Current();
+
+		ReportFile temp = ctx.includeStack.front();
+		ctx.includeStack.pop_back();
 		return temp;
 	}
 
-	void ReportsManager::PrintReport(size_t where, ReportType type, std::string const& msg)
+	void ReportsManager::formatText(std::string& out, ReportBuffer::Record const& record,
+									std::vector<size_t> const& lineStarts)
 	{
-		if (!includeStack.empty())
+		ReportsContext& ctx = Current();
+		std::string const& source = *ctx.currentFile.source;
+
+		for (auto const& e : ctx.includeStack)
 		{
-			for (auto const& e : includeStack)
-			{
-				std::cout << "In file included from \"" << e.fileName << "\":" << std::endl;
-			}
+			out += "In file included from \"" + e.fileName + "\":\n";
 		}
 		
-		ErrorPos pos = getErrorPos(where);
+		ErrorPos pos = getErrorPos(record.where, lineStarts);
 		
-		std::cout << TermColor::BrightWhite << currentFile.fileName << ":" <<
-			pos.lineNumber << ":" << pos.column << " ";
+		out += TermColor::BrightWhite + ctx.currentFile.fileName + ":" +
+			std::to_string(pos.lineNumber) + ":" + std::to_string(pos.column) + " ";
 		
-		switch (type)
+		switch (record.type)
 		{
 		case ReportType::ERROR:
-			std::cout << TermColor::BrightRed << "error";
+			out += TermColor::BrightRed;
 			break;
 		case ReportType::WARNING:
-			std::cout << TermColor::BrightMagenta << "warning";
+			out += TermColor::BrightMagenta;
 			break;
 		case ReportType::NOTE:
-			std::cout << "note";
 			break;
 		}
+		out += severity(record.type);
 		
-		std::cout  << TermColor::BrightWhite << ": " << msg << std::endl;
+		out += TermColor::BrightWhite + ": " + record.msg + "\n";
 
 		std::string prefix = " " + std::to_string(pos.lineNumber) + " | ";
 		
-		std::cout << prefix << TermColor::Reset <<
-			tabTransform(currentFile.source->substr(pos.startPos, pos.endPos - pos.startPos + 1)) << std::endl;
-		std::cout << std::string(pos.column + prefix.size(), ' ') << TermColor::BrightGreen << "^";
+		out += prefix + TermColor::Reset;
+		appendTabTransformed(out, source, pos.startPos, pos.endPos + 1);
+		out += "\n";
+		out += std::string(pos.column + prefix.size(), ' ') + TermColor::BrightGreen + "^";
 
-		for (size_t i = pos.where + 1; isalnum((*currentFile.source)[i]) ||
-				 (*currentFile.source)[i] == '.' || (*currentFile.source)[i] == '_'; i++)
+		for (size_t i = pos.where + 1; i < source.size() &&
+				 (isalnum(source[i]) || source[i] == '.' || source[i] == '_'); i++)
 		{
-			std::cout << "~";
+			out += "~";
 		}
-		std::cout << TermColor::Reset << std::endl;
+		out += TermColor::Reset + "\n";
 	}
-	
-	void ReportsManager::ReportError(size_t where, const std::string &msg, bool noStop)
+
+	void ReportsManager::formatJson(std::string& out, ReportBuffer::Record const& record,
+									std::vector<size_t> const& lineStarts)
 	{
-		errorsCount++;
+		ReportsContext& ctx = Current();
+
+		ErrorPos pos = getErrorPos(record.where, lineStarts);
+
+		out += "{\"file\":";
+		appendJsonString(out, ctx.currentFile.fileName);
+		out += ",\"line\":" + std::to_string(pos.lineNumber);
+		out += ",\"column\":" + std::to_string(pos.where - pos.startPos + 1);
+		out += ",\"severity\":\"";
+		out += severity(record.type);
+		out += "\",\"message\":";
+		appendJsonString(out, record.msg);
+		out += "}\n";
+	}
+
+	void ReportsManager::formatSarif(std::string& out, ReportBuffer::Record const* group, size_t size,
+									 std::vector<size_t> const& lineStarts)
+	{
+		ReportsContext& ctx = Current();
+
+		auto location = [&](ReportBuffer::Record const& record)
+		{
+			ErrorPos pos = getErrorPos(record.where, lineStarts);
+
+			out += "{\"physicalLocation\":{\"artifactLocation\":{\"uri\":";
+			appendJsonString(out, ctx.currentFile.fileName);
+			out += "},\"region\":{\"startLine\":" + std::to_string(pos.lineNumber) +
+				",\"startColumn\":" + std::to_string(pos.where - pos.startPos + 1) + "}}";
+		};
+
+		out += "{\"level\":\"";
+		out += severity(group[0].type);
+		out += "\",\"message\":{\"text\":";
+		appendJsonString(out, group[0].msg);
+		out += "},\"locations\":[";
+		location(group[0]);
+		out += "}]";
+
+		// Notes of the report
+		if (size > 1)
+		{
+			out += ",\"relatedLocations\":[";
+			for (size_t i = 1; i < size; i++)
+			{
+				if (i != 1) out += ',';
+				location(group[i]);
+				out += ",\"message\":{\"text\":";
+				appendJsonString(out, group[i].msg);
+				out += "}}";
+			}
+			out += "]";
+		}
+
+		out += "}";
+	}
+
+	bool ReportsManager::AddReport(size_t where, ReportType type, std::string const& msg,
+								   std::atomic<unsigned>* categoryCount)
+	{
+		ReportsContext& ctx = Current();
+		ReportBuffer& buffer = ctx.threadBuffer();
+
+		if (type == ReportType::NOTE)
+		{
+			if (!buffer.dropping) buffer.records.push_back({ where, type, msg });
+			return true;
+		}
+
+		auto range = buffer.recordsAt.equal_range(where);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			auto const& record = buffer.records[it->second];
+			if (record.type == type && record.msg == msg)
+			{
+				buffer.dropping = true;
+				return false;
+			}
+		}
+
+		if (categoryCount != nullptr && ctx.categoryLimit != 0 && ++*categoryCount > ctx.categoryLimit)
+		{
+			ctx.suppressedCount++;
+			buffer.dropping = true;
+			return true;
+		}
+
+		buffer.recordsAt.insert({ where, buffer.records.size() });
+		buffer.records.push_back({ where, type, msg });
+		buffer.dropping = false;
+		return true;
+	}
+
+	void ReportsManager::AddError(size_t where, std::string const& msg,
+								  std::atomic<unsigned>* categoryCount, bool noStop)
+	{
+		ReportsContext& ctx = Current();
+
+		if (ctx.listener != nullptr) ctx.listener->onReport(where, ReportType::ERROR, msg);
+
+		// Another thread has reached the limit
+		if (ctx.maxErrorsReached)
+			throw StopExecution();
+
+		if (AddReport(where, ReportType::ERROR, msg, categoryCount))
+		{
+			unsigned count = ++ctx.errorsCount;
+
+			if (ctx.maxErrors != 0 && count >= ctx.maxErrors)
+			{
+				ctx.maxErrorsReached = true;
+				throw StopExecution();
+			}
+		}
+
+		if (!noStop)
+			throw StopExecution();
+	}
+
+	void ReportsManager::HideError(bool noStop)
+	{
+		ReportsContext& ctx = Current();
+
+		// Later passes rely on the checks the error failed, so it stops the
+		// compilation like a shown one. Its notes are dropped with it.
+		ctx.threadBuffer().dropping = true;
+		ctx.hiddenCount++;
+		ctx.errorsCount++;
 
-		PrintReport(where, ReportType::ERROR, msg);
-		
 		if (!noStop)
 			throw StopExecution();
 	}
 
+	void ReportsManager::AddWarning(size_t where, std::string const& msg,
+									std::atomic<unsigned>* categoryCount, bool noStop)
+	{
+		ReportsContext& ctx = Current();
+
+		// Listener gets the original type, -Werror only changes the look
+		if (ctx.listener != nullptr) ctx.listener->onReport(where, ReportType::WARNING, msg);
+
+		if (AddReport(where, ((ctx.treatWarningsAsError) ? (ReportType::ERROR) : (ReportType::WARNING)), msg, categoryCount))
+			ctx.warningsCount++;
+
+		if (!noStop)
+			throw StopExecution();
+	}
+	
+	void ReportsManager::ReportError(size_t where, const std::string &msg, bool noStop)
+	{
+		AddError(where, msg, nullptr, noStop);
+	}
+
 	void ReportsManager::ReportError(size_t where, ErrorType type, bool noStop)
 	{
-		if (find(disallowedErrors.begin(), disallowedErrors.end(), type) != disallowedErrors.end())
+		ReportsContext& ctx = Current();
+		size_t index = static_cast<size_t>(type);
+
+		if (ctx.disallowedErrors[index])
 		{
+			HideError(noStop);
 			return;
 		}
 
-		ReportError(where, typeToString(type), noStop);
+		AddError(where, typeToString(type), &ctx.errorsByType[index], noStop);
 	}
 
 	void ReportsManager::ReportError(size_t where, ErrorType type,
 									 std::string const& additionalMsg, bool noStop)
 	{
-		if (find(disallowedErrors.begin(), disallowedErrors.end(), type) != disallowedErrors.end())
+		ReportsContext& ctx = Current();
+		size_t index = static_cast<size_t>(type);
+
+		if (ctx.disallowedErrors[index])
 		{
+			HideError(noStop);
 			return;
 		}
 
-		ReportError(where, typeToString(type) + additionalMsg, noStop);
+		AddError(where, typeToString(type) + additionalMsg, &ctx.errorsByType[index], noStop);
 	}
 	
 	void ReportsManager::ReportWarning(size_t where, const std::string &msg, bool noStop)
 	{
-		warningsCount++;
-
-		PrintReport(where, ((treatWarningsAsError) ? (ReportType::ERROR) : (ReportType::WARNING)), msg);
-		
-		if (!noStop)
-			throw StopExecution();
+		AddWarning(where, msg, nullptr, noStop);
 	}
 
 	void ReportsManager::ReportWarning(size_t where, WarningType type)
 	{
-		if (find(disallowedWarnings.begin(), disallowedWarnings.end(), type) != disallowedWarnings.end())
+		ReportsContext& ctx = Current();
+		size_t index = static_cast<size_t>(type);
+
+		if (ctx.disallowedWarnings[index])
 		{
 			return;
 		}
 
-		ReportWarning(where, typeToString(type));
+		AddWarning(where, typeToString(type), &ctx.warningsByType[index], true);
 	}
 
 	void ReportsManager::ReportWarning(size_t where, WarningType type, std::string const& additionalMsg)
 	{
-		if (find(disallowedWarnings.begin(), disallowedWarnings.end(), type) != disallowedWarnings.end())
+		ReportsContext& ctx = Current();
+		size_t index = static_cast<size_t>(type);
+
+		if (ctx.disallowedWarnings[index])
 		{
 			return;
 		}
 
-		ReportWarning(where, typeToString(type) + additionalMsg);
+		AddWarning(where, typeToString(type) + additionalMsg, &ctx.warningsByType[index], true);
 	}
 
-	ReportsManager::ErrorPos ReportsManager::getErrorPos(size_t where)
+	ReportsManager::ErrorPos ReportsManager::getErrorPos(size_t where, std::vector<size_t> const& lineStarts)
 	{
+		ReportsContext& ctx = Current();
+		std::string const& source = *ctx.currentFile.source;
+
 		ErrorPos res;
 		res.where = where;
-	
-		for (res.endPos = where; res.endPos < currentFile.source->size(); res.endPos++)
-		{
-			if ((*currentFile.source)[res.endPos] == '\n')
-			{
-				res.endPos--;
-				break;
-			}
-		}
 
-		for (res.startPos = where; res.startPos != 0; res.startPos--)
-		{
-			if ((*currentFile.source)[res.startPos] == '\n')
-			{
-				res.startPos++;
-				break;
-			}
-		}
+		size_t line = std::upper_bound(lineStarts.begin(), lineStarts.end(), where) - lineStarts.begin() - 1;
 
-		res.lineNumber = 0;
-		for (size_t i = res.endPos; i != static_cast<size_t>(-1); i--)
-		{
-			if ((*currentFile.source)[i] == '\n')
-				res.lineNumber++;
-		}
-		
-	    size_t tabAdjust = 0;
-		for (size_t i = res.startPos; i <= res.where; i++)
+		res.lineNumber = line + 1;
+		res.startPos = lineStarts[line];
+
+		if (line + 1 < lineStarts.size())
+			res.endPos = lineStarts[line + 1] - 2;
+		else
+			res.endPos = source.size();
+
+		size_t tabAdjust = 0;
+		for (size_t i = res.startPos; i <= res.where && i < source.size(); i++)
 		{
-			if ((*currentFile.source)[i] == '\t')
+			if (source[i] == '\t')
 			{
 				tabAdjust += 3;
 			}
 		}
 		res.column = res.where - res.startPos + tabAdjust;
 
-		//printf("\n[%zu:%zu - %zu] \'%c\'\n", res.startPos, res.endPos, res.where, (*currentFile)[res.where]);
-
-		res.lineNumber++;
 		return res;
 	}
 
@@ -255,9 +747,14 @@ namespace Pascal
 			return "can't parse literal";
 		case ErrorType::DIVISION_BY_ZERO:
 			return "division by zero";
+		case ErrorType::UNTERMINATED_STRING:
+			return "unterminated string";
+		case ErrorType::ILLEGAL_CHAR:
+			return "illegal character";
 		case ErrorType::NONE:
 			return "NONE ERROR";
 		}
+		return "unknown error";
 	}
 
 	std::string ReportsManager::typeToString(WarningType type)
@@ -268,24 +765,36 @@ namespace Pascal
 			return "using unintialized variable";
 		case WarningType::UNUSED_VAR:
 			return "unused variable";
+		case WarningType::UNKNOWN_ESCAPE_CHAR:
+			return "unknown escape character";
 		case WarningType::NONE:
 			return "NONE WARNING";
 		}
+		return "unknown warning";
 	}
 
 	unsigned ReportsManager::GetErrorsCount()
 	{
-		return errorsCount;
+		return Current().errorsCount;
 	}
 
 	unsigned ReportsManager::GetWarningsCount()
 	{
-		return warningsCount;
+		return Current().warningsCount;
 	}
 
 	void ReportsManager::ReportNote(size_t where, const std::string &msg)
 	{
-		PrintReport(where, ReportType::NOTE, msg);
+		ReportsContext& ctx = Current();
+
+		if (ctx.listener != nullptr) ctx.listener->onReport(where, ReportType::NOTE, msg);
+
+		AddReport(where, ReportType::NOTE, msg, nullptr);
+	}
+
+	void ReportsManager::SetListener(ReportListener* newListener)
+	{
+		Current().listener = newListener;
 	}
 }
 
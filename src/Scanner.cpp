@@ -9,7 +9,7 @@ namespace Pascal
 {
 	namespace
 	{
-		std::map<std::string, TokenType> PascalKeywords = {
+		const std::map<std::string, TokenType> PascalKeywords = {
 			{"program", TokenType::PROGRAM},
 			{"procedure", TokenType::PROCEDURE},
 			{"begin", TokenType::BEGIN},
@@ -81,6 +81,7 @@ namespace Pascal
 		case ',': addToken(TokenType::COMMA); break;
 		case ';': addToken(TokenType::SEMICOLON); break;
 		case ':': addToken(match('=') ? TokenType::COLON_EQUAL : TokenType::COLON); break;
+		case '=': addToken(TokenType::EQUAL); break;
 		case '/':
 			if (match('/')) 
 			{
@@ -177,9 +178,10 @@ namespace Pascal
 
 		std::string str = m_Source->substr(start, current - start);
 
-		if (PascalKeywords.count(str))
+		auto keyword = PascalKeywords.find(str);
+		if (keyword != PascalKeywords.end())
 		{
-			m_Res->push_back(Token(PascalKeywords[str], str, start));
+			m_Res->push_back(Token(keyword->second, str, start));
 		}
 		else
 		{
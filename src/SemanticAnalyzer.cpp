@@ -1,17 +1,16 @@
 #include <SemanticAnalyzer.hpp>
 
-#include <SemanticAnalyzer.hpp>
 #include <AST.hpp>
 #include <ReportsManager.hpp>
-#include <map>
+#include <TypeTable.hpp>
+#include <Intrinsics.hpp>
 
 namespace Pascal
 {
     SemanticAnalyzer::SemanticAnalyzer()
-        : currentScope(std::make_shared<Environment<SymAttribs>>()),
-          globalScope(std::make_shared<Environment<SymAttribs>>())
+        : walker(this), assigned(nullptr)
     {
-        globalScope->defineBuiltins({}); // TODO: ??
+
     }
 
     SemanticAnalyzer::~SemanticAnalyzer()
@@ -19,106 +18,136 @@ namespace Pascal
 
     }
 
-    void SemanticAnalyzer::visitProgramNode(const AST::ProgramNode& node)
+    void SemanticAnalyzer::run(const AST::Node& root)
     {
-        currentScope = globalScope;
+        assigned = nullptr;
+        walker.walk(root);
+    }
 
-        for (auto const& decl : node.decls)
-            decl->accept(this);
+    void SemanticAnalyzer::visitProgramNode(const AST::ProgramNode&)
+    {
 
-        node.compound->accept(this);
     }
 
-    void SemanticAnalyzer::visitCompoundNode(const AST::CompoundNode& node)
+    void SemanticAnalyzer::visitCompoundNode(const AST::CompoundNode&)
     {
-        for (auto const& stmt : node.stmts)
-            stmt->accept(this);
+
     }
 
     void SemanticAnalyzer::visitVarDeclNode(const AST::VarDeclNode& node)
     {
-        SymAttribs attrs;
-        node.type->accept(this);
-        attrs.type = lastType;
-        attrs.asVar.isGlobal = (currentScope == globalScope);
-        attrs.asVar.isConst = node.isConst;
-
-        currentScope->define(node.name.str, attrs);
+        // Evaluated by UndeclRedefinitionVisitor
+        if (node.value != nullptr && !node.symbol.hasValue)
+        {
+            ReportsManager::ReportError(node.name.pos, "constant value must be known at compile time");
+        }
 
-        lastSym = attrs;
+        // A value that isn't constant is reported once
+        walker.skipChildren();
     }
 
-    std::map<std::string, SymType> PascalTypes =
+    void SemanticAnalyzer::visitTypeNode(const AST::TypeNode&)
     {
-        {"integer", SymType::INTEGER},
-        {"long", SymType::LONG}
-    };
 
-    void SemanticAnalyzer::visitTypeNode(const AST::TypeNode& node)
-    {
-        lastType = PascalTypes[node.token.str];
     }
 
     void SemanticAnalyzer::visitProcDeclNode(const AST::ProcDeclNode& node)
     {
-        SymAttribs attrs;
-        attrs.type = SymType::PROCEDURE;
-        attrs.asProc.arity = node.params.size();
-        attrs.asProc.paramTypes = new SymType[node.params.size()];
-        for (unsigned i = 0; i < node.params.size(); i++)
+        if (node.isCached)
+            walker.skipChildren();
+    }
+
+    void SemanticAnalyzer::visitAssignmentNode(const AST::AssignmentNode& node)
+    {
+        // Symbols are resolved by UndeclRedefinitionVisitor
+        if (node.var->symbol.type == SymType::PROCEDURE)
+        {
+            ReportsManager::ReportError(node.var->token.pos, ErrorType::ILLEGAL_ASSIGNMENT);
+        }
+        else if (node.var->symbol.isConst)
         {
-            node.params[i]->type->accept(this);
-            attrs.asProc.paramTypes[i] = lastType;
+            ReportsManager::ReportError(node.var->token.pos, "attempt to assign constant variable");
         }
 
-        currentScope->define(node.name.str, attrs);
+        // The target is the first child, visited next
+        assigned = node.var.get();
+    }
 
-        auto oldScope = currentScope;
-        currentScope = std::make_shared<Environment<SymAttribs>>(globalScope);
+    void SemanticAnalyzer::visitVarNode(const AST::VarNode& node)
+    {
+        if (&node == assigned)
+        {
+            assigned = nullptr;
+            return;
+        }
 
-        for (auto const& decl : node.decls)
-            decl->accept(this);
+        // Procedures and builtins have no value
+        if (node.symbol.type == SymType::PROCEDURE)
+        {
+            ReportsManager::ReportError(node.token.pos, "attempt to use non-variable object as a value");
+        }
+    }
 
-        node.compound->accept(this);
+    void SemanticAnalyzer::visitIntLiteralNode(const AST::IntLiteralNode&)
+    {
 
-        currentScope = oldScope;
     }
 
-    void SemanticAnalyzer::visitAssignmentNode(const AST::AssignmentNode& node)
+    void SemanticAnalyzer::visitBinaryExprNode(const AST::BinaryExprNode&)
     {
-        node.var->accept(this);
-        if (lastSym.asVar.isConst)
-        {
-            ReportsManager::ReportError(node.var->token.pos, "attempt to assign constant variable");
-        }
 
-        node.expr->accept(this);
     }
 
-    void SemanticAnalyzer::visitVarNode(const AST::VarNode& node)
+    void SemanticAnalyzer::visitUnaryExprNode(const AST::UnaryExprNode&)
     {
-        lastSym = currentScope->lookupAndAncestors(node.token.str);
+
     }
 
-    void SemanticAnalyzer::visitIntLiteralNode(const AST::IntLiteralNode& node)
+    void SemanticAnalyzer::visitProcCallNode(const AST::CallStmtNode& node)
     {
-        uint32_t literal;
+        if (node.symbol.type != SymType::PROCEDURE)
+        {
+            ReportsManager::ReportError(node.name.pos, ErrorType::CALLING_NON_PROCEDURE);
+            return;
+        }
+
+        // Builtins are looked up by the index name resolution stored
+        unsigned arity = node.symbol.storage == StorageClass::BUILTIN
+            ? Intrinsics[node.symbol.slot].arity
+            : node.symbol.signature->arity();
 
+        if (arity != node.args.size())
+        {
+            ReportsManager::ReportError(node.name.pos, ErrorType::WRONG_ARGUMENTS_COUNT);
+        }
     }
 
-    void SemanticAnalyzer::visitBinaryExprNode(const AST::BinaryExprNode& node)
+    void SemanticAnalyzer::visitFunctionDeclNode(const AST::FunctionDeclNode&)
     {
 
     }
 
-    void SemanticAnalyzer::visitUnaryExprNode(const AST::UnaryExprNode& node)
+    void SemanticAnalyzer::visitIfNode(const AST::IfNode&)
     {
 
     }
 
-    void SemanticAnalyzer::visitProcCallNode(const AST::CallStmtNode& node)
+    void SemanticAnalyzer::visitFunctionCall(const AST::FunctionCallNode& node)
     {
+        if (node.symbol.type != SymType::PROCEDURE)
+        {
+            ReportsManager::ReportError(node.name.pos, ErrorType::CALLING_NON_FUNCTION);
+            return;
+        }
+
+        unsigned arity = node.symbol.storage == StorageClass::BUILTIN
+            ? Intrinsics[node.symbol.slot].arity
+            : node.symbol.signature->arity();
 
+        if (arity != node.args.size())
+        {
+            ReportsManager::ReportError(node.name.pos, ErrorType::WRONG_ARGUMENTS_COUNT);
+        }
     }
 
 } // namespace Pascal
@@ -0,0 +1,27 @@
+#include <Symbol.hpp>
+
+#include <map>
+
+namespace Pascal
+{
+	namespace
+	{
+		// Shared by all compilations, so it must not be modified
+		const std::map<std::string, SymType> PascalTypes =
+		{
+			{"integer", SymType::INTEGER},
+			{"long", SymType::LONG}
+		};
+	}
+
+	SymType GetSymType(std::string const& typeName)
+	{
+		auto type = PascalTypes.find(typeName);
+		return type != PascalTypes.end() ? type->second : SymType::INTEGER;
+	}
+
+	bool IsTypeName(std::string const& name)
+	{
+		return PascalTypes.count(name) != 0;
+	}
+} // namespace Pascal
@@ -0,0 +1,280 @@
+#include <TreeWalker.hpp>
+#include <AST.hpp>
+#include <NonConstVisitor.hpp>
+
+#include <algorithm>
+
+namespace Pascal
+{
+	namespace
+	{
+		// Appends direct children of a node in source order. Doesn't recurse.
+		class ChildrenCollector : public AST::Visitor
+		{
+		public:
+			ChildrenCollector(std::vector<const AST::Node*>& out)
+				: out(out)
+			{ }
+
+			void visitProgramNode(const AST::ProgramNode& node)
+			{
+				for (auto const& decl : node.decls)
+					add(decl.get());
+				add(node.compound.get());
+			}
+
+			void visitCompoundNode(const AST::CompoundNode& node)
+			{
+				for (auto const& stmt : node.stmts)
+					add(stmt.get());
+			}
+
+			void visitVarDeclNode(const AST::VarDeclNode& node)
+			{
+				add(node.type.get());
+				add(node.value.get());
+			}
+
+			void visitTypeNode(const AST::TypeNode&)
+			{ }
+
+			void visitProcDeclNode(const AST::ProcDeclNode& node)
+			{
+				for (auto const& param : node.params)
+					add(param.get());
+				for (auto const& decl : node.decls)
+					add(decl.get());
+				add(node.compound.get());
+			}
+
+			void visitAssignmentNode(const AST::AssignmentNode& node)
+			{
+				add(node.var.get());
+				add(node.expr.get());
+			}
+
+			void visitVarNode(const AST::VarNode&)
+			{ }
+
+			void visitIntLiteralNode(const AST::IntLiteralNode&)
+			{ }
+
+			void visitBinaryExprNode(const AST::BinaryExprNode& node)
+			{
+				add(node.left.get());
+				add(node.right.get());
+			}
+
+			void visitUnaryExprNode(const AST::UnaryExprNode& node)
+			{
+				add(node.expr.get());
+			}
+
+			void visitProcCallNode(const AST::CallStmtNode& node)
+			{
+				for (auto const& arg : node.args)
+					add(arg.get());
+			}
+
+			void visitFunctionDeclNode(const AST::FunctionDeclNode& node)
+			{
+				for (auto const& param : node.params)
+					add(param.get());
+				for (auto const& decl : node.decls)
+					add(decl.get());
+				add(node.compound.get());
+			}
+
+			void visitIfNode(const AST::IfNode& node)
+			{
+				add(node.condition.get());
+				add(node.thenArm.get());
+				add(node.elseArm.get());
+			}
+
+			void visitFunctionCall(const AST::FunctionCallNode& node)
+			{
+				for (auto const& arg : node.args)
+					add(arg.get());
+			}
+
+		private:
+			std::vector<const AST::Node*>& out;
+
+			void add(const AST::Node* node)
+			{
+				// Parser leaves nullptr's after syntax errors
+				if (node != nullptr) out.push_back(node);
+			}
+		};
+
+		// Moves ownership of direct children out of a node.
+		class ChildrenReleaser : public AST::NonConstVisitor
+		{
+		public:
+			ChildrenReleaser(std::vector<std::unique_ptr<AST::Node>>& out)
+				: out(out)
+			{ }
+
+			void visitProgramNode(AST::ProgramNode& node)
+			{
+				addAll(node.decls);
+				add(std::move(node.compound));
+			}
+
+			void visitCompoundNode(AST::CompoundNode& node)
+			{
+				addAll(node.stmts);
+			}
+
+			void visitVarDeclNode(AST::VarDeclNode& node)
+			{
+				add(std::move(node.type));
+				add(std::move(node.value));
+			}
+
+			void visitTypeNode(AST::TypeNode&)
+			{ }
+
+			void visitProcDeclNode(AST::ProcDeclNode& node)
+			{
+				addAll(node.params);
+				addAll(node.decls);
+				add(std::move(node.compound));
+			}
+
+			void visitAssignmentNode(AST::AssignmentNode& node)
+			{
+				add(std::move(node.var));
+				add(std::move(node.expr));
+			}
+
+			void visitVarNode(AST::VarNode&)
+			{ }
+
+			void visitIntLiteralNode(AST::IntLiteralNode&)
+			{ }
+
+			void visitBinaryExprNode(AST::BinaryExprNode& node)
+			{
+				add(std::move(node.left));
+				add(std::move(node.right));
+			}
+
+			void visitUnaryExprNode(AST::UnaryExprNode& node)
+			{
+				add(std::move(node.expr));
+			}
+
+			void visitProcCallNode(AST::CallStmtNode& node)
+			{
+				addAll(node.args);
+			}
+
+			void visitFunctionDeclNode(AST::FunctionDeclNode& node)
+			{
+				addAll(node.params);
+				addAll(node.decls);
+				add(std::move(node.compound));
+			}
+
+			void visitIfNode(AST::IfNode& node)
+			{
+				add(std::move(node.condition));
+				add(std::move(node.thenArm));
+				add(std::move(node.elseArm));
+			}
+
+			void visitFunctionCall(AST::FunctionCallNode& node)
+			{
+				addAll(node.args);
+			}
+
+		private:
+			std::vector<std::unique_ptr<AST::Node>>& out;
+
+			template <typename T>
+			void add(std::unique_ptr<T> node)
+			{
+				if (node != nullptr) out.push_back(std::move(node));
+			}
+
+			template <typename T>
+			void addAll(std::vector<std::unique_ptr<T>>& nodes)
+			{
+				for (auto& node : nodes)
+					add(std::move(node));
+				nodes.clear();
+			}
+		};
+	}
+
+	TreeWalker::TreeWalker(AST::Visitor* pre, AST::Visitor* post)
+		: pre(pre), post(post), skip(false), reverse(false)
+	{ }
+
+	void TreeWalker::walk(const AST::Node& root)
+	{
+		ChildrenCollector collector(children);
+
+		stack.clear();
+		stack.push_back({ &root, false });
+
+		while (!stack.empty())
+		{
+			Frame& top = stack.back();
+			const AST::Node* node = top.node;
+
+			if (top.entered)
+			{
+				stack.pop_back();
+				if (post != nullptr) node->accept(post);
+				continue;
+			}
+
+			top.entered = true;
+
+			skip = false;
+			reverse = false;
+			if (pre != nullptr) node->accept(pre);
+			if (skip) continue;
+
+			children.clear();
+			node->accept(&collector);
+
+			// The top of the stack is visited first
+			if (reverse)
+				std::reverse(children.begin(), children.end());
+
+			for (auto it = children.rbegin(); it != children.rend(); ++it)
+				stack.push_back({ *it, false });
+		}
+	}
+
+	void TreeWalker::skipChildren()
+	{
+		skip = true;
+	}
+
+	void TreeWalker::reverseChildren()
+	{
+		reverse = true;
+	}
+
+	void releaseTree(std::unique_ptr<AST::Node> root)
+	{
+		std::vector<std::unique_ptr<AST::Node>> pending;
+		ChildrenReleaser releaser(pending);
+
+		if (root != nullptr) pending.push_back(std::move(root));
+
+		while (!pending.empty())
+		{
+			std::unique_ptr<AST::Node> node = std::move(pending.back());
+			pending.pop_back();
+
+			// Node is destroyed at the end of the iteration without children
+			node->accept(&releaser);
+		}
+	}
+} // namespace Pascal
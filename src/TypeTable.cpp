@@ -0,0 +1,30 @@
+#include <TypeTable.hpp>
+
+#include <functional>
+
+namespace Pascal
+{
+	size_t TypeTable::Hash::operator()(const Signature* signature) const
+	{
+		size_t res = static_cast<size_t>(signature->result);
+		for (SymType type : signature->params)
+			res = res * 31 + static_cast<size_t>(type) + 1;
+
+		return std::hash<size_t>()(res);
+	}
+
+	const Signature* TypeTable::intern(std::vector<SymType> params, SymType result)
+	{
+		Signature key{ std::move(params), result };
+
+		auto found = m_Index.find(&key);
+		if (found != m_Index.end())
+			return *found;
+
+		m_Signatures.push_back(std::move(key));
+		const Signature* res = &m_Signatures.back();
+		m_Index.insert(res);
+
+		return res;
+	}
+} // namespace Pascal
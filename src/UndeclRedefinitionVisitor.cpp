@@ -1,14 +1,19 @@
 #include <UndeclRedefinitionVisitor.hpp>
 #include <AST.hpp>
 #include <ReportsManager.hpp>
+#include <Intrinsics.hpp>
+#include <ConstantFolder.hpp>
 
 namespace Pascal
 {
-	UndeclRedefinitionVisitor::UndeclRedefinitionVisitor()
-		: currentScope(std::make_shared<Environment<int>>()),
-		  globalScope(std::make_shared<Environment<int>>())
+	UndeclRedefinitionVisitor::UndeclRedefinitionVisitor(TypeTable& types)
+		: types(types),
+		  slotsCount(1, 0),
+		  paramsLeft(0),
+		  scopeExit(this),
+		  walker(this, &scopeExit)
 	{
-		globalScope->defineBuiltins(-1);
+		
 	}
 	
 	UndeclRedefinitionVisitor::~UndeclRedefinitionVisitor()
@@ -16,46 +21,129 @@ namespace Pascal
 		
 	}
 
-	void UndeclRedefinitionVisitor::check(const std::unique_ptr<AST::Node>& node)
+	void UndeclRedefinitionVisitor::run(const AST::Node& root)
 	{
-		node->accept(this);
+		walker.walk(root);
 	}
 
-	void UndeclRedefinitionVisitor::visitProgramNode(const AST::ProgramNode& node)
+	UndeclRedefinitionVisitor::ScopeExit::ScopeExit(UndeclRedefinitionVisitor* owner)
+		: owner(owner)
+	{ }
+
+	void UndeclRedefinitionVisitor::ScopeExit::visitVarDeclNode(const AST::VarDeclNode& node)
 	{
-		currentScope = globalScope;
-		
-		for (auto const& decl : node.decls)
-			decl->accept(this);
+		// Declared after the value is resolved, `const c: integer = c;`
+		// refers to an outer c
+		if (node.value != nullptr)
+			node.symbol.hasValue = EvaluateConstant(*node.value, node.symbol.type, node.symbol.value);
+
+		owner->declare(node.name, node.symbol);
+	}
+
+	void UndeclRedefinitionVisitor::ScopeExit::visitProcDeclNode(const AST::ProcDeclNode&)
+	{
+		owner->scopes.exitScope();
+		owner->slotsCount.pop_back();
+	}
+
+	void UndeclRedefinitionVisitor::ScopeExit::visitFunctionDeclNode(const AST::FunctionDeclNode&)
+	{
+		owner->scopes.exitScope();
+		owner->slotsCount.pop_back();
+	}
+
+	bool UndeclRedefinitionVisitor::declare(Token const& name, SymbolRef& symbol)
+	{
+		// Builtins belong to the global scope, procedures may shadow them
+		if (scopes.getDepth() == 0 && (IsTypeName(name.str) || FindIntrinsic(name.str.c_str()) != -1))
+		{
+			ReportsManager::ReportError(name.pos, ErrorType::NAME_REDEFINITION);
+			return false;
+		}
+
+		if (scopes.has(name.str))
+		{
+			ReportsManager::ReportError(name.pos, ErrorType::NAME_REDEFINITION);
+			ReportsManager::ReportNote(scopes.lookup(name.str).pos, "previous declared here");
+			return false;
+		}
+
+		symbol.depth = scopes.getDepth();
+		symbol.slot = slotsCount.back()++;
 
-		node.compound->accept(this);
+		scopes.define(name.str, { name.pos, symbol });
+		return true;
+	}
+
+	void UndeclRedefinitionVisitor::resolve(Token const& name, SymbolRef& symbol)
+	{
+		if (scopes.hasAndAncestors(name.str))
+		{
+			symbol = scopes.lookupAndAncestors(name.str).symbol;
+			return;
+		}
+
+		// Builtins aren't in the table, only names that miss it are checked
+		int intrinsic = FindIntrinsic(name.str.c_str());
+		if (intrinsic == -1)
+		{
+			ReportsManager::ReportError(name.pos, ErrorType::NAME_UNDEFINED);
+			return;
+		}
+
+		symbol = SymbolRef();
+		symbol.slot = static_cast<unsigned>(intrinsic);
+		symbol.type = SymType::PROCEDURE;
+		symbol.storage = StorageClass::BUILTIN;
+	}
+
+	template <typename Decl>
+	const Signature* UndeclRedefinitionVisitor::signatureOf(Decl const& node, SymType result)
+	{
+		std::vector<SymType> params;
+		params.reserve(node.params.size());
+
+		// Parameters may be skipped by the walker, their types are read here
+		for (auto const& param : node.params)
+			params.push_back(GetSymType(param->type->token.str));
+
+		return types.intern(std::move(params), result);
+	}
+
+	void UndeclRedefinitionVisitor::visitProgramNode(const AST::ProgramNode&)
+	{
+		
 	}
 	
-	void UndeclRedefinitionVisitor::visitCompoundNode(const AST::CompoundNode& node)
+	void UndeclRedefinitionVisitor::visitCompoundNode(const AST::CompoundNode&)
 	{
-		for (auto const& stmt : node.stmts)
-			stmt->accept(this);
+		
 	}
 	
 	void UndeclRedefinitionVisitor::visitVarDeclNode(const AST::VarDeclNode& node)
 	{
-		if (currentScope->has(node.name.str))
+		node.symbol.type = GetSymType(node.type->token.str);
+		node.symbol.isConst = node.isConst;
+
+		if (scopes.getDepth() == 0)
 		{
-			int previousPos = currentScope->lookup(node.name.str);
-			ReportsManager::ReportError(node.name.pos, ErrorType::NAME_REDEFINITION);
-			if (previousPos != -1) ReportsManager::ReportNote(previousPos, "previous declared here");
+			node.symbol.storage = StorageClass::GLOBAL;
+		}
+		else if (paramsLeft > 0)
+		{
+			// Parameters are visited before the other declarations
+			node.symbol.storage = StorageClass::PARAM;
+			paramsLeft--;
 		}
 		else
 		{
-			currentScope->define(node.name.str, node.name.pos);
+			node.symbol.storage = StorageClass::LOCAL;
 		}
-
-		node.type->accept(this);
 	}
 	
 	void UndeclRedefinitionVisitor::visitTypeNode(const AST::TypeNode& node)
 	{
-		if (!currentScope->hasAndAncestors(node.token.str))
+		if (!IsTypeName(node.token.str))
 		{
 			ReportsManager::ReportError(node.token.pos, ErrorType::NAME_UNDEFINED);
 		}
@@ -63,116 +151,71 @@ namespace Pascal
 	
 	void UndeclRedefinitionVisitor::visitProcDeclNode(const AST::ProcDeclNode& node)
 	{
-		if (currentScope->has(node.name.str))
-		{
-			int previousPos = currentScope->lookup(node.name.str);
-			ReportsManager::ReportError(node.name.pos, ErrorType::NAME_REDEFINITION);
-			ReportsManager::ReportNote(previousPos, "previous declared here");
-		}
-		else
-		{
-			currentScope->define(node.name.str, node.name.pos);
-		}
-
-		auto oldScope = currentScope;
-		currentScope = std::make_shared<Environment<int>>(currentScope);
-
-		for (auto const& e : node.params)
-			e->accept(this);
+		node.symbol.type = SymType::PROCEDURE;
+		node.symbol.storage = StorageClass::GLOBAL;
+		node.symbol.signature = signatureOf(node, SymType::PROCEDURE);
+		declare(node.name, node.symbol);
 
-		for (auto const& e : node.decls)
-			e->accept(this);
+		scopes.enterScope();
+		slotsCount.push_back(0);
+		paramsLeft = node.params.size();
 
-		node.compound->accept(this);
-
-		currentScope = oldScope;
+		// Cached procedures are resolved too, code generation needs the
+		// symbols. Their diagnostics duplicate the cached ones and are
+		// dropped by ReportsManager.
 	}
 	
-	void UndeclRedefinitionVisitor::visitAssignmentNode(const AST::AssignmentNode& node)
+	void UndeclRedefinitionVisitor::visitAssignmentNode(const AST::AssignmentNode&)
 	{
-		node.var->accept(this);
-		node.expr->accept(this);
+		
 	}
 	
 	void UndeclRedefinitionVisitor::visitVarNode(const AST::VarNode& node)
 	{
-		if (!currentScope->hasAndAncestors(node.token.str))
-		{
-			ReportsManager::ReportError(node.token.pos, ErrorType::NAME_UNDEFINED);
-		}
+		resolve(node.token, node.symbol);
 	}
 	
-	void UndeclRedefinitionVisitor::visitIntLiteralNode(const AST::IntLiteralNode& node)
+	void UndeclRedefinitionVisitor::visitIntLiteralNode(const AST::IntLiteralNode&)
 	{
 		
 	}
 		
-	void UndeclRedefinitionVisitor::visitUnaryExprNode(const AST::UnaryExprNode& node)
+	void UndeclRedefinitionVisitor::visitUnaryExprNode(const AST::UnaryExprNode&)
 	{
-		node.expr->accept(this);
+		
 	}
 	
 	void UndeclRedefinitionVisitor::visitProcCallNode(const AST::CallStmtNode& node)
 	{
-		if (!currentScope->hasAndAncestors(node.name.str))
-		{
-			ReportsManager::ReportError(node.name.pos, ErrorType::NAME_UNDEFINED);
-		}
-
-		for (auto const& e : node.args)
-			e->accept(this);
+		resolve(node.name, node.symbol);
 	}
 	
-	void UndeclRedefinitionVisitor::visitBinaryExprNode(const AST::BinaryExprNode& node)
+	void UndeclRedefinitionVisitor::visitBinaryExprNode(const AST::BinaryExprNode&)
 	{
-		node.left->accept(this);
-		node.right->accept(this);
+		
 	}
 
 	void UndeclRedefinitionVisitor::visitFunctionDeclNode(const AST::FunctionDeclNode& node)
 	{
-		if (currentScope->has(node.name.str))
-		{
-			int previousPos = currentScope->lookup(node.name.str);
-			ReportsManager::ReportError(node.name.pos, ErrorType::NAME_REDEFINITION);
-			ReportsManager::ReportNote(previousPos, "previous declared here");
-		}
-		else
-		{
-			currentScope->define(node.name.str, node.name.pos);
-		}
+		node.symbol.type = SymType::PROCEDURE;
+		node.symbol.storage = StorageClass::GLOBAL;
+		// There is no syntax for the result type yet
+		node.symbol.signature = signatureOf(node, SymType::INTEGER);
+		declare(node.name, node.symbol);
 
-		auto oldScope = currentScope;
-		currentScope = std::make_shared<Environment<int>>(currentScope);
-
-		for (auto const& e : node.params)
-			e->accept(this);
-
-		for (auto const& e : node.decls)
-			e->accept(this);
-
-		node.compound->accept(this);
-
-		currentScope = oldScope;
+		scopes.enterScope();
+		slotsCount.push_back(0);
+		paramsLeft = node.params.size();
 	}
 
-	void UndeclRedefinitionVisitor::visitIfNode(const AST::IfNode& node)
+	void UndeclRedefinitionVisitor::visitIfNode(const AST::IfNode&)
 	{
-		node.condition->accept(this);
-		node.thenArm->accept(this);
-
-		if (node.elseArm != nullptr) node.elseArm->accept(this);
+		
 	}
 
 	void UndeclRedefinitionVisitor::visitFunctionCall(const AST::FunctionCallNode& node)
 	{
-		if (!currentScope->hasAndAncestors(node.name.str))
-		{
-			ReportsManager::ReportError(node.name.pos, ErrorType::NAME_UNDEFINED);
-		}
-
-		for (auto const& e : node.args)
-			e->accept(this);
+		resolve(node.name, node.symbol);
 	}
 
 } // namespace Pascal
@@ -4,11 +4,10 @@
 
 namespace Pascal
 {
-    UsedInitializedVisitor::UsedInitializedVisitor()
-        : currentScope(std::make_shared<Environment<Attribs>>()),
-          globalScope(std::make_shared<Environment<Attribs>>())
+    UsedInitializedVisitor::UsedInitializedVisitor(const AnalysisCache* cache)
+        : cache(cache), assigned(nullptr), scopeExit(this), walker(this, &scopeExit)
     {
-        globalScope->defineBuiltins({true, true, static_cast<size_t>(-1)});
+
     }
     
     UsedInitializedVisitor::~UsedInitializedVisitor()
@@ -16,129 +15,197 @@ namespace Pascal
         
     }
 
+    void UsedInitializedVisitor::declare(Token const& name, SymbolRef const& symbol, Attribs attrs)
+    {
+        std::vector<Attribs>& scope = symbol.depth == 0 ? globals : locals;
+
+        if (scope.size() <= symbol.slot) scope.resize(symbol.slot + 1);
+        scope[symbol.slot] = attrs;
+
+        if (symbol.depth == 0) globalSlots[name.str] = symbol.slot;
+    }
+
+    UsedInitializedVisitor::Attribs* UsedInitializedVisitor::lookup(SymbolRef const& symbol)
+    {
+        switch (symbol.storage)
+        {
+        case StorageClass::GLOBAL:
+            return &globals[symbol.slot];
+        case StorageClass::PARAM:
+        case StorageClass::LOCAL:
+            return &locals[symbol.slot];
+        default:
+            return nullptr;
+        }
+    }
+
+    void UsedInitializedVisitor::exitScope(std::vector<Attribs> const& scope)
+    {
+        for (auto const& attrs : scope)
+        {
+            if (!attrs.used)
+            {
+                ReportsManager::ReportWarning(attrs.pos, WarningType::UNUSED_VAR);
+            }
+        }
+    }
+
+    void UsedInitializedVisitor::run(const AST::Node& root)
+    {
+        assigned = nullptr;
+        walker.walk(root);
+    }
+
     void UsedInitializedVisitor::check(const std::unique_ptr<AST::Node>& node)
     {
         node->accept(this);
     }
     
-    void UsedInitializedVisitor::visitProgramNode(const AST::ProgramNode& node)
+    void UsedInitializedVisitor::visitProgramNode(const AST::ProgramNode&)
     {
-        currentScope = globalScope;
-       
-        for (auto const& decl : node.decls)
-            decl->accept(this);
 
-        node.compound->accept(this);
     }
     
-    void UsedInitializedVisitor::visitCompoundNode(const AST::CompoundNode& node)
+    void UsedInitializedVisitor::visitCompoundNode(const AST::CompoundNode&)
     {
-        for (auto const& stmt : node.stmts)
-            stmt->accept(this);
 
-        for (auto& e : currentScope->getMap())
-        {
-            if (!e.second.used)
-            {
-                ReportsManager::ReportWarning(e.second.pos, WarningType::UNUSED_VAR);
-            }
-        }
     }
     
-    void UsedInitializedVisitor::visitVarDeclNode(const AST::VarDeclNode& node)
+    void UsedInitializedVisitor::visitVarDeclNode(const AST::VarDeclNode&)
     {
-        currentScope->define(node.name.str, { false, false, node.name.pos });
+        // The value is checked before the constant is declared, see ScopeExit
     }
     
-    void UsedInitializedVisitor::visitTypeNode(const AST::TypeNode& node)
+    void UsedInitializedVisitor::visitTypeNode(const AST::TypeNode&)
     {
         
     }
     
     void UsedInitializedVisitor::visitProcDeclNode(const AST::ProcDeclNode& node)
     {
-        currentScope->define(node.name.str, { false, true, node.name.pos });
-        
-        auto oldScope = currentScope;
-        currentScope = std::make_shared<Environment<Attribs>>(globalScope);
-
-        for (auto const& param : node.params)
-            param->accept(this);
-
-        for (auto const& decl : node.decls)
-            decl->accept(this);
-
-        node.compound->accept(this);
+        declare(node.name, node.symbol, { false, true, node.name.pos });
 
-        currentScope = oldScope;
+        if (node.isCached && cache != nullptr)
+        {
+            // Warnings of the body were reported by the cache, only the effect
+            // on globals is left
+            auto const& summary = cache->getSummary(node);
+            for (auto const& name : summary.used)
+                globals[globalSlots.at(name)].used = true;
+            for (auto const& name : summary.initialized)
+                globals[globalSlots.at(name)].initialized = true;
+
+            walker.skipChildren();
+            return;
+        }
+        
+        locals.clear();
     }
     
     void UsedInitializedVisitor::visitAssignmentNode(const AST::AssignmentNode& node)
     {
-        node.expr->accept(this);
-        Attribs& attrs = currentScope->lookupAndAncestors(node.var->token.str);
-        attrs.initialized = true;
-        attrs.used = true;
+        // The target is the first child, visited next. It is initialized
+        // by ScopeExit, after the expression.
+        assigned = node.var.get();
     }
     
     void UsedInitializedVisitor::visitVarNode(const AST::VarNode& node)
     {
-        Attribs& attrs = currentScope->lookupAndAncestors(node.token.str);
-        attrs.used = true;
+        if (&node == assigned)
+        {
+            assigned = nullptr;
+            return;
+        }
+
+        Attribs* attrs = lookup(node.symbol);
+        if (attrs == nullptr) return;
 
-        if (!attrs.initialized)
+        attrs->used = true;
+
+        if (!attrs->initialized)
         {
             ReportsManager::ReportWarning(node.token.pos, WarningType::UNINTIALIZED_VAR);
         }
     }
     
-    void UsedInitializedVisitor::visitIntLiteralNode(const AST::IntLiteralNode& node)
+    void UsedInitializedVisitor::visitIntLiteralNode(const AST::IntLiteralNode&)
     {
-        
+
+    }
+
+    void UsedInitializedVisitor::visitBinaryExprNode(const AST::BinaryExprNode&)
+    {
+
+    }
+
+    void UsedInitializedVisitor::visitUnaryExprNode(const AST::UnaryExprNode&)
+    {
+
     }
     
     void UsedInitializedVisitor::visitProcCallNode(const AST::CallStmtNode& node)
     {
-        Attribs& attrs = currentScope->lookupAndAncestors(node.name.str);
-        attrs.used = true;
-        
-        for (auto const& arg : node.args)
-            arg->accept(this);
+        Attribs* attrs = lookup(node.symbol);
+        if (attrs != nullptr) attrs->used = true;
     }
 
     void UsedInitializedVisitor::visitFunctionDeclNode(const AST::FunctionDeclNode& node)
     {
-        currentScope->define(node.name.str, { false, true, node.name.pos });
+        declare(node.name, node.symbol, { false, true, node.name.pos });
+
+        locals.clear();
+    }
+
+    void UsedInitializedVisitor::visitIfNode(const AST::IfNode&)
+    {
+
+    }
 
-        auto oldScope = currentScope;
-        currentScope = std::make_shared<Environment<Attribs>>(globalScope);
+    void UsedInitializedVisitor::visitFunctionCall(const AST::FunctionCallNode& node)
+    {
+        Attribs* attrs = lookup(node.symbol);
+        if (attrs != nullptr) attrs->used = true;
+    }
 
-        for (auto const& param : node.params)
-            param->accept(this);
+    UsedInitializedVisitor::ScopeExit::ScopeExit(UsedInitializedVisitor* owner)
+        : owner(owner)
+    {
 
-        for (auto const& decl : node.decls)
-            decl->accept(this);
+    }
 
-        node.compound->accept(this);
+    void UsedInitializedVisitor::ScopeExit::visitProgramNode(const AST::ProgramNode&)
+    {
+        owner->exitScope(owner->globals);
+    }
 
-        currentScope = oldScope;
+    void UsedInitializedVisitor::ScopeExit::visitVarDeclNode(const AST::VarDeclNode& node)
+    {
+        // Parameters get their value from the caller
+        bool initialized = node.value != nullptr || node.symbol.storage == StorageClass::PARAM;
+        owner->declare(node.name, node.symbol, { false, initialized, node.name.pos });
     }
 
-    void UsedInitializedVisitor::visitIfNode(const AST::IfNode& node)
+    void UsedInitializedVisitor::ScopeExit::visitProcDeclNode(const AST::ProcDeclNode& node)
     {
-        node.condition->accept(this);
-        node.thenArm->accept(this);
+        // Warnings of cached bodies are reported by the cache
+        if (node.isCached && owner->cache != nullptr)
+            return;
 
-        if (node.elseArm != nullptr) node.elseArm->accept(this);
+        owner->exitScope(owner->locals);
     }
 
-    void UsedInitializedVisitor::visitFunctionCall(const AST::FunctionCallNode& node)
+    void UsedInitializedVisitor::ScopeExit::visitAssignmentNode(const AST::AssignmentNode& node)
     {
-        Attribs& attrs = currentScope->lookupAndAncestors(node.name.str);
-        attrs.used = true;
+        Attribs* attrs = owner->lookup(node.var->symbol);
+        if (attrs == nullptr) return;
+
+        attrs->initialized = true;
+        attrs->used = true;
+    }
 
-        for (auto const& arg : node.args)
-            arg->accept(this);
+    void UsedInitializedVisitor::ScopeExit::visitFunctionDeclNode(const AST::FunctionDeclNode&)
+    {
+        owner->exitScope(owner->locals);
     }
     
 } // namespace Pascal
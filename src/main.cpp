@@ -7,16 +7,9 @@
 #include <sstream>
 
 #include <ReportsManager.hpp>
-#include <Scanner.hpp>
-#include <Parser.hpp>
-#include <AST.hpp>
-
-#include <UndeclRedefinitionVisitor.hpp>
-#include <UsedInitializedVisitor.hpp>
-//#include <CodeGenVisitor.hpp>
-#include <SemanticAnalyzer.hpp>
-
-void job(std::string const& inFileName, std::string const& outFileName, std::shared_ptr<std::string> prg);
+#include <Driver.hpp>
+#include <CompileServer.hpp>
+#include <BatchCompiler.hpp>
 
 int main(int argc, char** argv)
 {
@@ -40,46 +33,44 @@ int main(int argc, char** argv)
 		return 0;
 	}
 
-	Pascal::ReportsManager::Init(args);
-
-	std::string inFileName;
-	for (auto const& arg : args)
+	if (args[0] == "--server" || args[0] == "--client")
 	{
-		if (arg.rfind("-", 0) != 0)
+		if (args.size() < 2)
 		{
-			inFileName = arg;
-			break;
+			std::cout << "error: expected socket path" << std::endl;
+			return 2;
 		}
-	}
 
-	std::string outFileName = "";
-
-	for (auto it = args.begin(); it != args.end(); ++it)
-	{
-		if (*it == "-o")
+		if (args[0] == "--server")
 		{
-			++it;
-			if (it == args.end())
-			{
-				std::cout << "error: expected output file name" << std::endl;
-				return 2;
-			}
-
-			outFileName = *it;
-			break;
+			Pascal::CompileServer server(args[1]);
+			return server.run();
 		}
+
+		std::vector<std::string> forwarded(args.begin() + 2, args.end());
+		return Pascal::CompileServer::RunClient(args[1], forwarded);
+	}
+
+	if (Pascal::BatchCompiler::IsRequested(args))
+	{
+		Pascal::BatchCompiler batch(args);
+		return batch.run();
 	}
 
+	std::string inFileName = Pascal::Driver::GetInputFileName(args);
+	std::string outFileName = Pascal::Driver::GetOutputFileName(args);
+
 	if (outFileName == "")
 	{
-		outFileName = "out.asm";
+		std::cout << "error: expected output file name" << std::endl;
+		return 2;
 	}
 
 	std::ifstream fin(inFileName);
 	if (!fin.is_open())
 	{
 		std::cout << TermColor::BrightRed << "error" << TermColor::BrightWhite <<
-			": can't open file \"" << args[0] << "\"" << TermColor::Reset << std::endl;
+			": can't open file \"" << inFileName << "\"" << TermColor::Reset << std::endl;
 		return 2;
 	}
 
@@ -91,63 +82,19 @@ int main(int argc, char** argv)
 		*prg = ss.str();
 	}
 
-	job(inFileName, outFileName, prg);
-
-	if (Pascal::ReportsManager::GetWarningsCount() > 0)
-	{
-		if (Pascal::ReportsManager::GetErrorsCount() > 0)
-			std::cout << "Generated " << Pascal::ReportsManager::GetWarningsCount() <<
-			" warnings and " << Pascal::ReportsManager::GetErrorsCount() << " errors." << std::endl;
-		else
-			std::cout << "Generated " << Pascal::ReportsManager::GetWarningsCount() << " warnings." << std::endl;
-	}
-	else if (Pascal::ReportsManager::GetErrorsCount() > 0)
-		std::cout << "Generated " << Pascal::ReportsManager::GetErrorsCount() << " errors." << std::endl;
-
-	return 0;
-}
-
-void job(std::string const& inFileName, std::string const& outFileName, std::shared_ptr<std::string> prg)
-{
-	std::unique_ptr<Pascal::AST::ProgramNode> tree;
-
-	Pascal::ReportsManager::SetCurrentFile({ inFileName, prg });
+	Pascal::Driver driver(args);
+	int status = driver.compile(inFileName, prg, std::cout);
 
-	try
+	if (!driver.getOutput().empty())
 	{
+		std::ofstream fout(outFileName, std::ios::out | std::ios::binary);
+		if (!fout.is_open())
 		{
-			Pascal::Scanner scanner(prg);
-			Pascal::TokenList tokens = scanner.scanTokens();
-			Pascal::Parser parser(tokens);
-			tree = parser.parseProgram();
-		}
-
-		if (Pascal::ReportsManager::GetErrorsCount() != 0)
-			return;
-
-		Pascal::UndeclRedefinitionVisitor undeclPass;
-		tree->accept(&undeclPass);
-
-		if (Pascal::ReportsManager::GetErrorsCount() != 0)
-			return;
-
-		Pascal::SemanticAnalyzer semanticAnalyzer;
-		tree->accept(&semanticAnalyzer);
-
-		if (Pascal::ReportsManager::GetErrorsCount() != 0)
-			return;
-	
-		Pascal::UsedInitializedVisitor usedPass;
-		tree->accept(&usedPass);
-
-		if (Pascal::ReportsManager::GetErrorsCount() == 0)
-		{
-			//Pascal::CodeGenVisitor code(outFileName);
-			//tree->accept(&code);
+			std::cout << "error: couldn't open file '" << outFileName << "'" << std::endl;
+			return 2;
 		}
+		fout.write(driver.getOutput().data(), driver.getOutput().size());
 	}
-	catch (Pascal::StopExecution const& e)
-	{
-		return;
-	}
-}
\ No newline at end of file
+
+	return status;
+}
@@ -0,0 +1,137 @@
+// Compiles programs whose expressions are a million operators or
+// parentheses deep and whose statements are as deeply nested. The parser
+// keeps open statements and parentheses on explicit stacks and every later
+// pass walks the tree without recursion too, so this must pass on the
+// default stack.
+//
+// Built from the compiler sources without src/main.cpp, for example:
+//   g++ -std=c++14 -Iinclude tests/DeepNesting.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread
+
+#include <Driver.hpp>
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const unsigned Depth = 1000000;
+
+	// `term + term + ...`, nested on the left
+	std::string chain(std::string const& term)
+	{
+		std::string res = term;
+		res.reserve((term.size() + 3) * Depth);
+
+		for (unsigned i = 1; i < Depth; i++)
+			res += " + " + term;
+
+		return res;
+	}
+
+	// `open` Depth times, then `middle`, then `close` Depth times
+	std::string nested(std::string const& open, std::string const& middle, std::string const& close)
+	{
+		std::string res;
+		res.reserve((open.size() + close.size()) * Depth + middle.size());
+
+		for (unsigned i = 0; i < Depth; i++)
+			res += open;
+		res += middle;
+		for (unsigned i = 0; i < Depth; i++)
+			res += close;
+
+		return res;
+	}
+
+	// A procedure with `body` as its statements
+	std::string program(std::string const& body)
+	{
+		return
+			"program deep;\n"
+			"var x: integer;\n"
+			"procedure p(a: integer);\n"
+			"begin\n" +
+			body +
+			"end\n"
+			"begin\n"
+			"  p(3);\n"
+			"  make_bcd(x);\n"
+			"end.\n";
+	}
+
+	bool compiles(std::string const& name, std::string const& source, std::vector<std::string> args, int expected)
+	{
+		args.push_back("-S");
+
+		Pascal::Driver driver(args);
+		std::ostringstream diagnostics;
+		int status = driver.compile(name + ".pas", std::make_shared<std::string>(source), diagnostics);
+
+		bool ok = status == expected && (expected != 0 || !driver.getOutput().empty());
+		std::cout << (ok ? "ok     " : "FAILED ") << name << std::endl;
+		return ok;
+	}
+}
+
+int main()
+{
+	std::string sum = chain("a");
+	bool ok = true;
+
+	std::string procedure =
+		"program deep;\n"
+		"var x: integer;\n"
+		"procedure p(a: integer);\n"
+		"begin\n"
+		"  x := " + sum + ";\n"
+		"  if " + sum + " then\n"
+		"  begin\n"
+		"    x := 1;\n"
+		"  end\n"
+		"end\n"
+		"begin\n"
+		"  p(3);\n"
+		"  make_bcd(x);\n"
+		"end.\n";
+
+	ok = compiles("procedure", procedure, { "-fno-inline" }, 0) && ok;
+	ok = compiles("inlined", procedure, {}, 0) && ok;
+
+	std::string constant =
+		"program deep;\n"
+		"const c: integer = " + chain("1") + ";\n"
+		"begin\n"
+		"  make_bcd(c);\n"
+		"end.\n";
+
+	ok = compiles("constant", constant, {}, 0) && ok;
+
+	// Errors are reported and the tree is released the same way
+	std::string error =
+		"program deep;\n"
+		"var x: integer;\n"
+		"procedure p(a: integer);\n"
+		"begin\n"
+		"  x := " + sum + " + p;\n"
+		"end\n"
+		"begin\n"
+		"  p(3);\n"
+		"end.\n";
+
+	ok = compiles("error", error, {}, 1) && ok;
+
+	ok = compiles("blocks", program(nested("begin ", "x := a;", " end") + "\n"), {}, 0) && ok;
+	ok = compiles("ifs", program(nested("if a then ", "x := a;", "") + "\n"), {}, 0) && ok;
+	ok = compiles("else ifs", program(nested("if a then x := a; else ", "x := 1;", "") + "\n"), {}, 0) && ok;
+	ok = compiles("parentheses", program("x := " + nested("(", "a", ")") + ";\n"), {}, 0) && ok;
+	ok = compiles("right sum", program("x := " + nested("(a + ", "a", ")") + ";\n"), {}, 0) && ok;
+
+	// A missing ';' at the bottom, the statements around it are dropped
+	ok = compiles("statement error", program(nested("begin if a then ", "x := a", " end") + "\n"), {}, 1) && ok;
+	ok = compiles("parenthesis error", program("x := " + nested("(a + ", "a", "") + ";\n"), {}, 1) && ok;
+
+	return ok ? 0 : 1;
+}
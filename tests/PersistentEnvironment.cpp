@@ -0,0 +1,242 @@
+// Checks PersistentEnvironment: snapshots don't see later definitions,
+// scopes shadow and restore names, names with equal or partly equal hashes
+// share leaves, and random sequences of operations give the same results
+// as Environment.
+//
+// Header only, for example:
+//   g++ -std=c++14 -Iinclude tests/PersistentEnvironment.cpp
+
+#include <PersistentEnvironment.hpp>
+#include <Environment.hpp>
+
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Pascal::PersistentEnvironment;
+
+	// Every name in the same leaf
+	struct SameHash
+	{
+		size_t operator()(std::string const&) const { return 7; }
+	};
+
+	// Lengths 1, 33 and 65 agree in the bits of the first level only, so
+	// their leaves move down when the others are added
+	struct LengthHash
+	{
+		size_t operator()(std::string const& name) const { return name.size(); }
+	};
+
+	bool report(std::string const& name, bool ok)
+	{
+		std::cout << (ok ? "ok     " : "FAILED ") << name << std::endl;
+		return ok;
+	}
+
+	template <typename Env>
+	bool throwsOnLookup(Env const& env, std::string const& name)
+	{
+		try
+		{
+			env.lookup(name);
+		}
+		catch (std::out_of_range const&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	bool snapshots()
+	{
+		PersistentEnvironment<int> env;
+		env.define("a", 1);
+		env.define("b", 2);
+
+		PersistentEnvironment<int> snapshot = env;
+		env.define("c", 3);
+		env.enterScope();
+		env.define("a", 10);
+
+		bool ok = snapshot.size() == 2 && !snapshot.hasAndAncestors("c") &&
+			snapshot.getDepth() == 0 && snapshot.lookup("a") == 1;
+
+		// And the other way round
+		snapshot.define("d", 4);
+		ok = ok && !env.hasAndAncestors("d") && env.size() == 3 && env.lookup("a") == 10;
+
+		return ok;
+	}
+
+	bool shadowing()
+	{
+		PersistentEnvironment<int> env;
+		bool ok = env.define("x", 1) && env.define("y", 2);
+
+		// Redefinition in the same scope keeps the first value
+		ok = ok && !env.define("x", 3) && env.lookup("x") == 1;
+
+		env.enterScope();
+		ok = ok && env.getDepth() == 1 && !env.has("x") && env.hasAndAncestors("x");
+		ok = ok && throwsOnLookup(env, "y") && env.lookupAndAncestors("y") == 2;
+
+		// Shadowing doesn't add a visible name
+		ok = ok && env.define("x", 10) && env.define("z", 11);
+		ok = ok && env.lookup("x") == 10 && env.size() == 3;
+
+		env.enterScope();
+		ok = ok && env.define("x", 100) && env.lookupAndAncestors("x") == 100;
+		env.exitScope();
+		ok = ok && env.lookup("x") == 10 && env.getDepth() == 1;
+
+		env.exitScope();
+		ok = ok && env.getDepth() == 0 && env.lookup("x") == 1 && !env.hasAndAncestors("z") && env.size() == 2;
+
+		// Leaving the global scope drops everything
+		env.exitScope();
+		ok = ok && env.size() == 0 && !env.hasAndAncestors("x");
+
+		return ok;
+	}
+
+	bool sameHash()
+	{
+		PersistentEnvironment<int, SameHash> env;
+		bool ok = true;
+
+		for (int i = 0; i < 50; i++)
+			ok = env.define("n" + std::to_string(i), i) && ok;
+
+		PersistentEnvironment<int, SameHash> snapshot = env;
+
+		env.enterScope();
+		ok = ok && env.define("n7", 700) && env.define("m", 1) && !env.define("m", 2);
+		ok = ok && env.lookup("n7") == 700 && env.lookupAndAncestors("n8") == 8 && env.size() == 51;
+		ok = ok && snapshot.lookup("n7") == 7 && !snapshot.hasAndAncestors("m");
+		env.exitScope();
+
+		for (int i = 0; i < 50; i++)
+			ok = ok && env.lookup("n" + std::to_string(i)) == i;
+
+		return ok && env.size() == 50 && !env.hasAndAncestors("m") && !env.hasAndAncestors("n50");
+	}
+
+	bool partialHash()
+	{
+		PersistentEnvironment<int, LengthHash> env;
+		std::string names[] = { std::string(1, 'a'), std::string(1, 'b'), std::string(33, 'a'), std::string(65, 'a'), std::string(2, 'a') };
+
+		bool ok = true;
+		for (int i = 0; i < 5; i++)
+		{
+			PersistentEnvironment<int, LengthHash> before = env;
+			ok = env.define(names[i], i) && ok;
+
+			ok = ok && before.size() == static_cast<size_t>(i) && !before.hasAndAncestors(names[i]);
+			for (int j = 0; j <= i; j++)
+				ok = ok && env.lookup(names[j]) == j;
+		}
+
+		return ok && !env.has(std::string(33, 'b')) && !env.has(std::string(97, 'a'));
+	}
+
+	// Random definitions, scopes and snapshots against Environment. A
+	// snapshot must keep answering like the Environment did at its time.
+	bool againstEnvironment()
+	{
+		std::mt19937 random(1);
+		std::vector<std::string> names;
+		for (int i = 0; i < 300; i++)
+			names.push_back("v" + std::to_string(i));
+
+		struct Snapshot
+		{
+			PersistentEnvironment<int> env;
+			std::vector<int> has, value;
+		};
+
+		Pascal::Environment<int> reference;
+		PersistentEnvironment<int> env;
+		std::vector<Snapshot> snapshots;
+		bool ok = true;
+
+		auto state = [&](Snapshot& snapshot)
+		{
+			for (auto const& name : names)
+			{
+				bool visible = reference.hasAndAncestors(name);
+				snapshot.has.push_back(visible ? (reference.has(name) ? 2 : 1) : 0);
+				snapshot.value.push_back(visible ? reference.lookupAndAncestors(name) : 0);
+			}
+		};
+
+		auto matches = [&](PersistentEnvironment<int> const& env, Snapshot const& expected)
+		{
+			size_t visible = 0;
+			for (size_t i = 0; i < names.size(); i++)
+			{
+				int has = env.hasAndAncestors(names[i]) ? (env.has(names[i]) ? 2 : 1) : 0;
+				if (has != expected.has[i]) return false;
+				if (has != 0 && env.lookupAndAncestors(names[i]) != expected.value[i]) return false;
+				if (has != 0) visible++;
+			}
+			return env.size() == visible;
+		};
+
+		for (int step = 0; step < 20000 && ok; step++)
+		{
+			unsigned op = random() % 100;
+			if (op < 80)
+			{
+				std::string const& name = names[random() % names.size()];
+				int value = static_cast<int>(random() % 1000);
+				ok = reference.define(name, value) == env.define(name, value);
+			}
+			else if (op < 88)
+			{
+				reference.enterScope();
+				env.enterScope();
+			}
+			else if (op < 96)
+			{
+				if (reference.getDepth() == 0) continue;
+				reference.exitScope();
+				env.exitScope();
+			}
+			else
+			{
+				snapshots.push_back({ env, {}, {} });
+				state(snapshots.back());
+			}
+
+			ok = ok && reference.getDepth() == env.getDepth();
+		}
+
+		Snapshot current{ env, {}, {} };
+		state(current);
+		ok = ok && matches(env, current);
+
+		for (auto const& snapshot : snapshots)
+			ok = ok && matches(snapshot.env, snapshot);
+
+		return ok;
+	}
+}
+
+int main()
+{
+	bool ok = true;
+
+	ok = report("snapshots", snapshots()) && ok;
+	ok = report("shadowing", shadowing()) && ok;
+	ok = report("same hash", sameHash()) && ok;
+	ok = report("partial hash", partialHash()) && ok;
+	ok = report("against Environment", againstEnvironment()) && ok;
+
+	return ok ? 0 : 1;
+}
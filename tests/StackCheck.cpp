@@ -0,0 +1,236 @@
+// Runs a recursive procedure built with -fstack-check as deep as the stack
+// zone allows and one level deeper. The deepest run must print every sum,
+// the one past it must stop in __stack_overflow__ instead of wrapping sp.
+//
+// Built from the compiler sources without src/main.cpp, for example:
+//   g++ -std=c++14 -Iinclude tests/StackCheck.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread
+
+#include <Driver.hpp>
+#include <Chip8Assembler.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum class Stop
+	{
+		HALT,		// jump to itself, the end of the main program
+		BREAK,		// sys 0, __stack_overflow__
+		FAULT
+	};
+
+	// The instructions the compiler emits, display and timers do nothing.
+	// Values stored by `ld B, vX` are collected in `printed`.
+	struct Machine
+	{
+		uint8_t memory[Pascal::Chip8Assembler::MemorySize] = {};
+		uint8_t v[16] = {};
+		unsigned i = 0;
+		unsigned pc = Pascal::Chip8Assembler::LoadAddress;
+		std::vector<unsigned> calls;
+		std::vector<unsigned> printed;
+
+		Stop run(std::string const& rom)
+		{
+			const unsigned MaxSteps = 1000000;
+
+			for (size_t k = 0; k < rom.size(); k++)
+				memory[Pascal::Chip8Assembler::LoadAddress + k] = static_cast<uint8_t>(rom[k]);
+
+			for (unsigned step = 0; step < MaxSteps; step++)
+			{
+				if (pc + 1 >= sizeof(memory)) return Stop::FAULT;
+
+				unsigned word = memory[pc] << 8 | memory[pc + 1];
+				unsigned x = (word >> 8) & 0xF;
+				unsigned y = (word >> 4) & 0xF;
+				unsigned nn = word & 0xFF;
+				unsigned nnn = word & 0xFFF;
+				pc += 2;
+
+				switch (word >> 12)
+				{
+				case 0x0:
+					if (word == 0x00E0) break;
+					if (word != 0x00EE) return word == 0 ? Stop::BREAK : Stop::FAULT;
+					if (calls.empty()) return Stop::FAULT;
+					pc = calls.back();
+					calls.pop_back();
+					break;
+				case 0x1:
+					if (nnn == pc - 2) return Stop::HALT;
+					pc = nnn;
+					break;
+				case 0x2:
+					calls.push_back(pc);
+					pc = nnn;
+					break;
+				case 0x3: if (v[x] == nn) pc += 2; break;
+				case 0x4: if (v[x] != nn) pc += 2; break;
+				case 0x5: if (v[x] == v[y]) pc += 2; break;
+				case 0x6: v[x] = static_cast<uint8_t>(nn); break;
+				case 0x7: v[x] = static_cast<uint8_t>(v[x] + nn); break;
+				case 0x8:
+					if (!arithmetic(word & 0xF, x, y)) return Stop::FAULT;
+					break;
+				case 0x9: if (v[x] != v[y]) pc += 2; break;
+				case 0xA: i = nnn; break;
+				case 0xB: pc = nnn + v[0]; break;
+				case 0xD: break;
+				case 0xF:
+					if (!misc(nn, x)) return Stop::FAULT;
+					break;
+				default:
+					return Stop::FAULT;
+				}
+			}
+
+			return Stop::FAULT;
+		}
+
+		bool arithmetic(unsigned op, unsigned x, unsigned y)
+		{
+			unsigned res = 0, flag = 0;
+			switch (op)
+			{
+			case 0x0: v[x] = v[y]; return true;
+			case 0x1: v[x] |= v[y]; return true;
+			case 0x2: v[x] &= v[y]; return true;
+			case 0x3: v[x] ^= v[y]; return true;
+			case 0x4: res = v[x] + v[y]; flag = res > 0xFF; break;
+			case 0x5: res = v[x] - v[y]; flag = v[x] >= v[y]; break;
+			case 0x6: res = v[x] >> 1; flag = v[x] & 1; break;
+			case 0x7: res = v[y] - v[x]; flag = v[y] >= v[x]; break;
+			case 0xE: res = v[x] << 1; flag = v[x] >> 7; break;
+			default: return false;
+			}
+
+			v[x] = static_cast<uint8_t>(res);
+			v[0xF] = static_cast<uint8_t>(flag);
+			return true;
+		}
+
+		bool misc(unsigned op, unsigned x)
+		{
+			if (op == 0x55 || op == 0x65 || op == 0x33)
+			{
+				if (i + x >= sizeof(memory)) return false;
+			}
+
+			switch (op)
+			{
+			case 0x07: v[x] = 0; return true;
+			case 0x15: case 0x18: return true;
+			case 0x1E: i += v[x]; return true;
+			case 0x29: i = v[x] * 5; return true;
+			case 0x33:
+				printed.push_back(v[x]);
+				memory[i] = v[x] / 100;
+				memory[i + 1] = v[x] / 10 % 10;
+				memory[i + 2] = v[x] % 10;
+				return true;
+			case 0x55:
+				for (unsigned r = 0; r <= x; r++) memory[i + r] = v[r];
+				return true;
+			case 0x65:
+				for (unsigned r = 0; r <= x; r++) v[r] = memory[i + r];
+				return true;
+			default:
+				return false;
+			}
+		}
+	};
+
+	// r(d) prints 15 * d + 65 after the call for d - 1 returns. Its frame is
+	// 31 units, so with the saved bp each level takes 32 of the 256 units
+	// sp addresses: 7 levels fit, the 8th would end at the last unit and
+	// leave sp at 256.
+	std::string program(unsigned depth)
+	{
+		std::string decls, body, sum = "d";
+		for (unsigned k = 1; k <= 10; k++)
+		{
+			std::string name = "a" + std::to_string(k);
+			decls += "var " + name + ": integer;\n";
+			body += "  " + name + " := d + " + std::to_string(k) + ";\n";
+			sum += " + " + name;
+		}
+		for (unsigned k = 1; k <= 4; k++)
+		{
+			std::string name = "b" + std::to_string(k);
+			decls += "var " + name + ": long;\n";
+			body += "  " + name + " := d + " + std::to_string(k) + ";\n";
+			sum += " + " + name;
+		}
+
+		return
+			"program r;\n"
+			"var n: integer;\n"
+			"var s: integer;\n"
+			"procedure r(d: integer);\n" +
+			decls +
+			"begin\n" +
+			body +
+			"  if d then\n"
+			"  begin\n"
+			"    r(d - 1);\n"
+			"  end\n"
+			"  s := " + sum + ";\n"
+			"  make_bcd(s);\n"
+			"end\n"
+			"begin\n"
+			"  s := 0;\n"
+			"  n := " + std::to_string(depth) + ";\n"
+			"  r(n);\n"
+			"end.\n";
+	}
+
+	bool runs(unsigned depth, bool fits)
+	{
+		Pascal::Driver driver({ "-fno-inline", "-fstack-check" });
+		std::ostringstream diagnostics;
+		int status = driver.compile("depth" + std::to_string(depth) + ".pas",
+									std::make_shared<std::string>(program(depth)), diagnostics);
+
+		bool ok = status == 0;
+		if (ok)
+		{
+			Machine machine;
+			Stop stop = machine.run(driver.getOutput());
+
+			// make_bcd prints the low and the high byte of every sum
+			std::vector<unsigned> expected;
+			for (unsigned d = 0; d <= depth; d++)
+			{
+				expected.push_back((15 * d + 65) & 0xFF);
+				expected.push_back(0);
+			}
+
+			if (fits)
+				ok = stop == Stop::HALT && machine.printed == expected;
+			else
+				ok = stop == Stop::BREAK && machine.printed.empty();
+		}
+
+		std::cout << (ok ? "ok     " : "FAILED ") << "depth " << depth << (fits ? "" : ", overflow") << std::endl;
+		return ok;
+	}
+}
+
+int main()
+{
+	bool ok = true;
+
+	for (unsigned depth = 0; depth <= 6; depth++)
+		ok = runs(depth, true) && ok;
+
+	ok = runs(7, false) && ok;
+	ok = runs(40, false) && ok;
+
+	return ok ? 0 : 1;
+}